@@ -10,9 +10,16 @@
  *
  * @section Features
  *  - Converts analog expression pedal movements into MIDI Control Change (CC) messages.
- *  - Accepts a standard sustain pedal (switch) and sends MIDI CC messages accordingly.
+ *  - Accepts a standard sustain pedal (switch) and sends MIDI CC messages accordingly. The pedal is edge triggered
+ *    (INT1), so a press goes out on the next loop pass and only the bounces after it are filtered.
  *  - Programmable CC assignments for both expression and sustain pedals via incoming MIDI messages.
+ *  - 8 presets kept in RAM, switched with Program Change within one loop pass.
  *  - Dead zone adjustment to compensate for low-precision potentiometers.
+ *  - Optional 14 bit (MSB/LSB) output with ADC oversampling for smooth sweeps.
+ *  - Built-in response curves (linear, log, exp, S-curve, reverse) selectable per pedal.
+ *  - Rate limited expression output that drops superseded values and always delivers the resting value.
+ *  - Timing statistics of the main loop stages, readable over SysEx.
+ *  - Interrupt driven background sampling of the expression pedal, the main loop never waits on the ADC.
  *  - EEPROM storage for persistent CC assignments across power cycles.
  *  - MIDI input handling for configuration.
  *  - USB MIDI output for compatibility with DAWs and MIDI-enabled software.
@@ -39,10 +46,24 @@
  *  - To change the device name (e.g., "Amits Expresso Midi controller"), copy the `hardware` folder to your `Documents/Arduino` folder. If the folder already exists, copy the contents of the included `hardware` folder to your `Documents/Arduino/hardware` folder. Edit the `boards.txt` file to change the name.
  */
 
+#include "ATADC.h"
+#include "ATDINMIDI.h"
+#include "ATMIDIIN.h"
+#include "ATMIDIOUT.h"
 #include "ATPOTS.h"
+#include "ATQUEUE.h"
+#include "ATROUTER.h"
+#include "ATSCHED.h"
+#include "ATSTATS.h"
+#include "ATSTORE.h"
+#include "ATSYSEX.h"
+#include "ATTRACE.h"
+#include "ATUSBMIDI.h"
 #include <EEPROM.h>
 #include <MIDI.h>
 #include <USB-MIDI.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
 
 // Create a default USBMIDI instance.
 USBMIDI_CREATE_DEFAULT_INSTANCE();
@@ -57,7 +78,7 @@ USBMIDI_CREATE_DEFAULT_INSTANCE();
 #define blinker 9
 /** @brief Default MIDI channel. */
 #define MIDI_CH 1
-/** @brief Debounce time for the sustain pedal in milliseconds. */
+/** @brief Debounce time for the sustain pedal in milliseconds, edges inside this window after a change are ignored. */
 #define debounceMS 50
 
 // ========== MIDI CC Configuration ==========
@@ -77,6 +98,164 @@ USBMIDI_CREATE_DEFAULT_INSTANCE();
 #define pedalExpCh 39
 /** @brief MIDI CC number to set the MIDI output channel for the sustain pedal (values 1-16). */
 #define pedalSustainCh 40
+/** @brief MIDI CC number to select the expression pedal resolution (0-63 7 bit, 64-127 14 bit MSB/LSB pairs). */
+#define pedalHiRes 41
+/** @brief MIDI CC number to set the expression pedal message rate limit (0 unlimited, 1-127 = value x 10 messages per second). */
+#define pedalRate 42
+/** @brief MIDI CC number to select the expression pedal response curve (0 linear, 1 log, 2 exp, 3 S-curve, 4 reverse). */
+#define pedalCurve 43
+/** @brief MIDI CC number to set the expression pedal adaptive smoothing (0 off, 1-127 = heavier smoothing at rest). */
+#define pedalSmoothing 44
+/** @brief MIDI CC number to set how fast the adaptive smoothing opens up on movement (0-127). */
+#define pedalResponse 45
+/** @brief MIDI CC number to calibrate the expression pedal travel (64-127 start, 0-63 stop and save). */
+#define pedalCalibrate 46
+/** @brief MIDI CC number to select the output ports of the pedals (1 USB, 2 DIN, 3 both). */
+#define pedalPorts 47
+/** @brief MIDI CC number to capture a raw trace of the expression pedal (1-63 now, 65-127 on movement, 0 stops). */
+#define pedalCapture 48
+
+// ========== Scheduler ==========
+/** @brief Scheduler tick rate (Timer3), in ticks per second. */
+#define tickHz 1000
+/** @brief Ticks between two pedal scans, the pedal is sampled and dispatched at tickHz / scanTicks. */
+#define scanTicks 1
+/** @brief Run time budget of the pedal scan task in microseconds, one scan period. */
+#define scanBudgetUS (1000000UL / tickHz * scanTicks)
+/** @brief Run time budget of the sustain task in microseconds. */
+#define sustainBudgetUS 100
+/** @brief Run time budget of the housekeeping task in microseconds, a few EEPROM reads and one write started. */
+#define housekeepingBudgetUS 100
+
+// ========== MIDI Input ==========
+/** @brief Time `handleMidiInput()` may spend on waiting messages per loop pass, in microseconds. */
+#define midiBudgetUS 500
+/** @brief MIDI channel the configuration CCs and Program Changes are received on. */
+#define configChannel 1
+
+// ========== SysEx Commands ==========
+/** @brief SysEx command to dump the timing statistics (F0 7D 41 10 [01 = reset after dump] F7). */
+#define sysexStats 0x10
+/** @brief SysEx reply carrying the output counters, sent after the timing statistics. */
+#define sysexCounters 0x11
+/** @brief SysEx command to request the configuration (F0 7D 41 20 F7). */
+#define sysexConfigRequest 0x20
+/** @brief SysEx reply carrying the configuration, answer to `sysexConfigRequest`. */
+#define sysexConfigDump 0x21
+/** @brief SysEx command to apply a configuration (F0 7D 41 22 <configuration> [01 = save] F7). */
+#define sysexConfigLoad 0x22
+/** @brief SysEx reply to `sysexConfigLoad` carrying the status (0 = applied). */
+#define sysexConfigAck 0x23
+/** @brief SysEx command to request an extra expression pedal destination (F0 7D 41 24 <route> F7). */
+#define sysexRouteRequest 0x24
+/** @brief SysEx reply carrying an extra destination, answer to `sysexRouteRequest`. */
+#define sysexRouteDump 0x25
+/** @brief SysEx command to set an extra destination (F0 7D 41 26 <route> <CC> <channel> <curve> <ports> [01 = save] F7). */
+#define sysexRouteLoad 0x26
+/** @brief SysEx command starting the on-device benchmark: `F0 7D 41 30 <pattern> <seconds> F7`. */
+#define sysexBenchStart 0x30
+/** @brief SysEx reply with the benchmark results, sent when the run is over. */
+#define sysexBenchReport 0x31
+/** @brief SysEx command asking for an immediate echo: `F0 7D 41 40 <token> F7`. */
+#define sysexPing 0x40
+/** @brief SysEx echo of `sysexPing` with the pedal's timestamps. */
+#define sysexPong 0x41
+/** @brief Maximum number of token bytes echoed by `sysexPong`. */
+#define pingTokenSize 4
+/** @brief SysEx command restarting the pedal into the bootloader: `F0 7D 41 50 42 4F 4F 54 F7` ("BOOT"). */
+#define sysexBootloader 0x50
+/** @brief SysEx command for the noise profile: `F0 7D 41 60 [01] F7`, 01 profiles the pedal now. */
+#define sysexProfile 0x60
+/** @brief SysEx reply with the noise profile and the filter it picked. */
+#define sysexProfileReport 0x61
+/** @brief SysEx command to export the raw trace of the expression pedal: `F0 7D 41 70 F7`. */
+#define sysexCapture 0x70
+/** @brief SysEx reply describing the exported trace, sent ahead of its chunks. */
+#define sysexCaptureHeader 0x71
+/** @brief SysEx reply carrying one chunk of the exported trace. */
+#define sysexCaptureChunk 0x72
+
+// ========== Bootloader ==========
+/** @brief Value the Caterina bootloader looks for after a watchdog reset to stay in the bootloader. */
+#define bootKey 0x7777
+/** @brief RAM address of the boot key, as in the bootloader (`bootKeyPtr`). */
+#define bootKeyAddress 0x0800
+/** @brief Version of the configuration layout sent with `sysexConfigDump` and `sysexConfigLoad`. */
+#define sysexConfigVersion 3
+/** @brief Length of the configuration payload: version, 13 field bytes and the checksum. */
+#define sysexConfigSize 15
+/** @brief Length of the `sysexRouteLoad` payload: route, CC, channel, curve and ports. */
+#define sysexRouteSize 5
+
+// ========== SysEx Configuration Status ==========
+/** @brief The configuration was applied. */
+#define configOK 0
+/** @brief The configuration has the wrong length or version. */
+#define configBadVersion 1
+/** @brief The configuration checksum does not match. */
+#define configBadChecksum 2
+/** @brief A configuration field is out of range. */
+#define configBadValue 3
+
+// ========== Timing Statistics ==========
+/** @brief Index of the expression pedal scan and output stage statistics. */
+#define statScan 0
+/** @brief Index of the sustain pedal stage statistics. */
+#define statSustain 1
+/** @brief Index of the MIDI input and USB write stage statistics. */
+#define statMidi 2
+/** @brief Index of the loop period statistics. */
+#define statLoop 3
+/** @brief Index of the sustain latency statistics, from the captured edge to the queued message. */
+#define statLatency 4
+/** @brief Number of timed stages. */
+#define statCount 5
+
+// ========== Benchmark ==========
+/** @brief Benchmark pattern: triangle sweep over the whole travel. */
+#define benchSweep 1
+/** @brief Benchmark pattern: random readings over the whole travel. */
+#define benchNoise 2
+/** @brief Raw reading steps the sweep moves per scan. */
+#define benchSweepStep 8
+/** @brief Longest benchmark run (seconds). */
+#define benchMaxSeconds 60
+
+// ========== Noise Profile ==========
+/** @brief Length of a noise profile (ms), the pedal has to stay at rest. */
+#define profileMS 1000
+/** @brief Moving average window until the pedal was profiled. */
+#define defaultReadings 15
+/** @brief Debounce threshold until the pedal was profiled. */
+#define defaultThreshold 5
+/** @brief Profile status: the profile was taken and its filter applied. */
+#define profileOK 0
+/** @brief Profile status: a profile is already running. */
+#define profileBusy 1
+/** @brief Profile status: the pedal moved, the previous filter stays. */
+#define profileMoved 2
+/** @brief Profile status: the pedal was never profiled. */
+#define profileNone 3
+
+// ========== Trace Capture ==========
+/** @brief Trace bytes per `sysexCaptureChunk`, 7 packed groups fill one message. */
+#define captureChunkBytes 49
+/** @brief Movement that starts an armed capture (10 bit steps). */
+#define captureTrigger 8
+
+// ========== Idle ==========
+/** @brief Quiet time after which the pedal goes idle (ms), 0 keeps it at full rate. */
+#define idleMS 30000UL
+/** @brief Scheduler ticks between two pedal samples while idle (20 ticks = 50 Hz), also the Timer3 stride then. */
+#define idleScanTicks 20
+/** @brief Change of a raw reading (10 bit steps) that wakes the pedal. */
+#define wakeThreshold 4
+
+// ========== Input Events ==========
+/** @brief Event source id of the sustain pedal, the pots of `BANK` use 0, 1, ... */
+#define sourceSustain 0x10
+/** @brief Number of sustain edges that can wait for `handleSustain()` (a power of two). */
+#define eventQueueSize 8
 
 // ========== CC Value Limits ==========
 /** @brief Lower limit for settable CC values. */
@@ -94,30 +273,93 @@ const byte EXP_CC = 11;
 /** @brief Unique identifier for the board. */
 const char ID[] = "ATEXPSO";
 
+// ========== Configuration Layout ==========
+/** @brief Layout version of `PEDALSTATE` in EEPROM, bump it whenever the structure changes. */
+#define configLayout 7
+
+// ========== Presets ==========
+/** @brief Number of presets, selected with Program Change 0 ... presetCount - 1. */
+#define presetCount 8
+/** @brief Extra expression pedal destinations per preset, on top of the main `ECC` one. */
+#define extraRoutes 2
+static_assert(extraRoutes + 1 <= ATROUTER_ROUTES, "the router holds the main and the extra destinations");
+static_assert(ATROUTER_ROUTES <= ATDINMIDI_SLOTS, "every DIN destination gets a slot");
+
 // ========== Default Dead Zone ==========
-/** @brief Default dead zone percentage for the expression pedal. */
-const float DEADZONE = 10.00f;
+/** @brief Default dead zone of the expression pedal, in tenths of a percent (10%). */
+const uint16_t DEADZONE = 10 * ATPOT_DEADZONE_SCALE;
+
+// ========== Default Resolution ==========
+/** @brief Default resolution of the expression pedal (false = 7 bit, true = 14 bit). */
+const bool HIRES = false;
+
+// ========== Default Output Rate ==========
+/** @brief Default expression pedal message rate limit, in steps of 10 messages per second (0 = unlimited). */
+const byte RATE = 20;
+
+// ========== Default Response Curve ==========
+/** @brief Default response curve of the expression pedal. */
+const byte CURVE = ATPOT_CURVE_LINEAR;
+
+// ========== Default Adaptive Smoothing ==========
+/** @brief Default adaptive smoothing of the expression pedal (0 = off). */
+const byte SMOOTHING = 0;
+/** @brief Default response of the adaptive smoothing to pedal movement. */
+const byte RESPONSE = 32;
+
+// ========== Default Output Ports ==========
+/** @brief Default output ports of the pedals (`ATROUTE_USB`, `ATROUTE_DIN` or both). */
+const byte PORTS = ATROUTE_USB;
 
 // ========== Global Variables ==========
-/** @brief Current CC number for the expression pedal. */
-byte ECC = EXP_CC;
-/** @brief Current CC number for the sustain pedal. */
-byte SCC = SUSTAIN_CC;
-/** @brief Current MIDI channel for the expression pedal. */
-byte expCH = MIDI_CH;
-/** @brief Current MIDI channel for the sustain pedal. */
-byte sustainCH = MIDI_CH;
+/** @brief MIDI input of the pedal, channel messages for other channels are skipped. */
+ATMIDIIN<decltype(MIDI)> MIDIIN(MIDI, configChannel);
 /** @brief Last known state of the sustain pedal. */
 byte lastState = LOW;
-/** @brief Timestamp of the last sustain pedal scan. */
-unsigned long lastScan = 0;
-/** @brief Current state of the sustain pedal. */
-bool currentState = LOW;
+/** @brief Timestamp (micros) of the last accepted sustain pedal edge, only used by `sustainEdge()`. */
+unsigned long sustainEdgeAt = 0;
+/** @brief Pin level `sustainEdge()` queued last, set by `handleSustain()` on a correction. */
+volatile byte sustainLevel = LOW;
+/** @brief Sustain edges captured by `sustainEdge()`, waiting for `handleSustain()`. */
+ATQUEUE<ATEVENT, eventQueueSize> EVENTS;
+/** @brief Set when the pin still has to be checked once the debounce window is over. */
+bool sustainVerify = true;
+/** @brief Capture time (micros) of the last handled sustain edge, the debounce window starts there. */
+unsigned long sustainVerifyAt = 0;
+/** @brief Set while the pedal is idle: the ADC is paused and the CPU sleeps between ticks. */
+bool idle = false;
+/** @brief Set while the USB host has suspended the bus. */
+bool suspended = false;
+/** @brief Last time (millis) the pedal moved, a sustain edge came in or MIDI was received. */
+unsigned long activeAt = 0;
+/** @brief Scheduler ticks since the last pedal sample while idle. */
+/** @brief Noise profile of the expression pedal, filled while `profiling` is set. */
+ATPOTNOISE NOISE;
+/** @brief Set while the noise profile is taken. */
+bool profiling = false;
+/** @brief Whether the running noise profile is reported with `sysexProfileReport` when done. */
+bool profileReport = false;
+/** @brief Start time of the running noise profile (millis). */
+unsigned long profileStartedAt = 0;
+/** @brief Raw trace of the expression pedal, recorded after `pedalCapture`. */
+ATTRACE TRACE;
+/** @brief Time between two samples of the trace source (us), taken when the capture starts. */
+uint16_t capturePeriod = 0;
+/** @brief Pattern of the running benchmark (`benchSweep`, `benchNoise`), 0 when none runs. */
+byte benchPattern = 0;
+/** @brief Start time of the running benchmark (millis). */
+unsigned long benchStartedAt = 0;
+/** @brief Length of the running benchmark (ms). */
+unsigned long benchLength = 0;
+/** @brief Number of pedal scans during the running benchmark. */
+unsigned long benchScans = 0;
+/** @brief Timing statistics of the main loop stages, indexed by `statScan` ... `statLatency`. */
+ATSTAT STATS[statCount];
 
 /**
- * @brief Structure to store the pedal's configuration settings.
+ * @brief Structure to store the settings of one preset.
  */
-struct PEDALSTATE {
+struct PRESET {
     /** @brief Expression pedal CC number. */
     byte ECC;
     /** @brief Sustain pedal CC number. */
@@ -126,19 +368,61 @@ struct PEDALSTATE {
     byte CH_EXPRESSION;
     /** @brief MIDI channel for the sustain pedal. */
     byte CH_SUSTAIN;
-    /** @brief Dead zone percentage for the expression pedal. */
-    float DEADZONE;
+    /** @brief Dead zone of the expression pedal, in tenths of a percent. */
+    uint16_t DEADZONE;
+    /** @brief High resolution (14 bit) mode for the expression pedal. */
+    bool HIRES;
+    /** @brief Expression pedal message rate limit in steps of 10 messages per second (0 = unlimited). */
+    byte RATE;
+    /** @brief Expression pedal response curve (`ATPOT_CURVE_LINEAR` ... `ATPOT_CURVE_REVERSE`). */
+    byte CURVE;
+    /** @brief Adaptive smoothing of the expression pedal at rest (0 = off). */
+    byte SMOOTHING;
+    /** @brief How fast the adaptive smoothing follows pedal movement. */
+    byte RESPONSE;
+    /** @brief Output ports of the expression and sustain pedals (`ATROUTE_USB`, `ATROUTE_DIN`). */
+    byte PORTS;
+    /** @brief Extra destinations of the expression pedal, each with its own CC, channel, curve and ports. */
+    ATROUTE ROUTES[extraRoutes];
+};
+
+/**
+ * @brief Structure to store the pedal's configuration settings, all the presets and the active one.
+ */
+struct PEDALSTATE {
+    /** @brief The presets. */
+    PRESET PRESETS[presetCount];
+    /** @brief Number of the active preset. */
+    byte ACTIVE;
+    /** @brief Raw reading at the heel end of the expression pedal travel, set by calibration. */
+    int TRAVEL_LOW;
+    /** @brief Raw reading at the toe end of the expression pedal travel, set by calibration. */
+    int TRAVEL_HIGH;
+    /** @brief Moving average window picked by the noise profile, 0 until the pedal was profiled. */
+    byte READINGS;
+    /** @brief Debounce threshold picked by the noise profile. */
+    byte THRESHOLD;
+    /** @brief Raw spread measured by the noise profile (10 bit steps). */
+    byte NOISE_SPREAD;
+    /** @brief Standard deviation measured by the noise profile (1/16 of a 10 bit step). */
+    uint16_t NOISE_DEVIATION;
     /** @brief Board identifier. */
     char ID[sizeof(ID)];
 };
 
+/** @brief The configuration, mirrored from EEPROM at boot. Switching presets never reads the EEPROM. */
+PEDALSTATE STATE;
+/** @brief The active preset, points into `STATE`. */
+PRESET* preset = &STATE.PRESETS[0];
+
 /**
- * @brief Callback function called when the expression pedal value changes.
+ * @brief Puts one Control Change message on the USB MIDI transport.
  *
- * @param newValue The new value of the expression pedal (0-127).
- * @param oldValue The previous value of the expression pedal (0-127).
+ * @param cc The MIDI CC number.
+ * @param value The CC value (0-127).
+ * @param ch The MIDI channel (1-16).
  */
-void expressionChanged(byte newValue, byte oldValue);
+void sendCC(byte cc, byte value, byte ch);
 
 /**
  * @brief Loads the pedal configuration from EEPROM.
@@ -150,15 +434,294 @@ void loadConfig();
  */
 void saveConfig();
 
-// Create an instance of the ATPOT class for the expression pedal.
-// ATPOT POT(pEXP, 0, 127, DEADZONE);
-/** @brief Instance of the ATPOT class to manage the expression pedal. */
-ATPOT POT(pEXP, 0, 127, DEADZONE, expressionChanged);
+/**
+ * @brief Fills a preset with the default settings.
+ *
+ * @param P The preset to fill.
+ */
+void defaultPreset(PRESET& P);
+
+/**
+ * @brief Instance of the ATPOT class to manage the expression pedal, its destinations are in `ROUTER`.
+ *
+ * @details Only the pot's filter, travel and dead zone feed the output, through `linearPosition`.
+ *          Curves and hysteresis are applied per destination by `ROUTER`, so the pot's own curve,
+ *          7 bit value and `setHysteresis()` stay at their defaults here. They serve sketches that
+ *          send a pot directly (`ATMIDICCPOT`), with the same hysteresis test as the router.
+ */
+ATPOT POT(pEXP, 0, 127);
+
+// ========== RAM Budget ==========
+/** @brief Analog inputs the RAM is planned for. */
+#define plannedInputs 8
+/** @brief Bytes of RAM the pots of `plannedInputs` may take next to the rest of the sketch. */
+#define potRAM 720
+static_assert(plannedInputs * ATPOT_BYTES <= potRAM, "the pots outgrew potRAM, lower ATPOT_MAX_READINGS or count the inputs again");
+
+/** @brief All the analog inputs of the unit, sampled in turn in the background. Add more pots here. */
+ATPOT* PEDALS[] = { &POT };
+/** @brief Bank scanning the analog inputs. */
+ATPOTBANK BANK(PEDALS);
+/** @brief Raw readings of `PEDALS` when the pedal went idle, moving away from them wakes it. */
+int idleReadings[sizeof(PEDALS) / sizeof(PEDALS[0])];
+
+/** @brief Wear levelled EEPROM store holding the saved `PEDALSTATE`. */
+ATSTORE STORE(configLayout, sizeof(PEDALSTATE));
+
+/** @brief Rate limited output stage for the expression pedal messages. */
+ATMIDIOUT OUT(sendCC);
+
+/** @brief Collects the CC messages of a loop pass and writes them to USB in one transfer. */
+ATUSBMIDI PACKETS;
+
+/** @brief Non-blocking writer for the 5-pin DIN MIDI output on `Serial1`. */
+ATDINMIDI DIN(Serial1);
+
+/** @brief Fans the expression pedal out to its destinations on the USB (`OUT`) and DIN ports. */
+ATROUTER ROUTER(&OUT, &DIN);
+
+/** @brief Runs the pedal, sustain and MIDI tasks from the Timer3 tick. */
+ATSCHED SCHED;
+
+/**
+ * @brief Sets the CC number of the expression pedal (`setEXP`).
+ *
+ * @param value The CC number (0-110, 0 disables the pedal).
+ */
+void configExpressionCC(byte value)
+{
+    preset->ECC = constrain(value, setLOW, setHIGH);
+    applyRoutes();
+}
+
+/**
+ * @brief Sets the CC number of the sustain pedal (`setSustain`).
+ *
+ * @param value The CC number (0-110, 0 disables the pedal).
+ */
+void configSustainCC(byte value)
+{
+    preset->SCC = constrain(value, setLOW, setHIGH);
+}
+
+/**
+ * @brief Resets the pedal to default settings on an even value (`pedalReset`).
+ *
+ * @param value The received value.
+ */
+void configReset(byte value)
+{
+    if (constrain(value, setLOW, setHIGH) % 2 == 0)
+        initPedal();
+}
+
+/**
+ * @brief Saves the configuration to EEPROM on 127 (`pedalSave`).
+ *
+ * @param value The received value.
+ */
+void configSave(byte value)
+{
+    if (value == 127)
+        saveConfig();
+}
+
+/**
+ * @brief Loads the configuration from EEPROM on 127 (`pedalLoad`).
+ *
+ * @param value The received value.
+ */
+void configLoad(byte value)
+{
+    if (value == 127)
+        loadConfig();
+}
+
+/**
+ * @brief Sets the dead zone of the expression pedal (`pedalDeadZone`).
+ *
+ * @param value The dead zone in percent (1-50).
+ */
+void configDeadZone(byte value)
+{
+    preset->DEADZONE = constrain(value, 1, 50) * ATPOT_DEADZONE_SCALE;
+    POT.setDeadZoneTenths(preset->DEADZONE);
+}
+
+/**
+ * @brief Sets the MIDI channel of the expression pedal (`pedalExpCh`).
+ *
+ * @param value The channel (1-16).
+ */
+void configExpressionChannel(byte value)
+{
+    preset->CH_EXPRESSION = constrain(value, 1, 16);
+    applyRoutes();
+}
+
+/**
+ * @brief Sets the MIDI channel of the sustain pedal (`pedalSustainCh`).
+ *
+ * @param value The channel (1-16).
+ */
+void configSustainChannel(byte value)
+{
+    preset->CH_SUSTAIN = constrain(value, 1, 16);
+}
+
+/**
+ * @brief Selects the resolution of the expression pedal (`pedalHiRes`).
+ *
+ * @param value 0-63 for 7 bit, 64-127 for 14 bit.
+ */
+void configResolution(byte value)
+{
+    preset->HIRES = value >= 64;
+    POT.setHighResolution(preset->HIRES);
+    ROUTER.setHighResolution(preset->HIRES);
+}
+
+/**
+ * @brief Sets the message rate limit of the expression pedal (`pedalRate`).
+ *
+ * @param value 0 for unlimited, otherwise value x 10 messages per second.
+ */
+void configRate(byte value)
+{
+    preset->RATE = value;
+    OUT.setRate(preset->RATE * 10);
+}
+
+/**
+ * @brief Selects the response curve of the expression pedal (`pedalCurve`).
+ *
+ * @param value The curve (`ATPOT_CURVE_LINEAR` ... `ATPOT_CURVE_REVERSE`).
+ */
+void configCurve(byte value)
+{
+    preset->CURVE = constrain(value, 0, ATPOT_CURVE_COUNT - 1);
+    applyRoutes();
+}
+
+/**
+ * @brief Sets the adaptive smoothing of the expression pedal (`pedalSmoothing`).
+ *
+ * @param value 0 for off, 1-127 for heavier smoothing while the pedal rests.
+ */
+void configSmoothing(byte value)
+{
+    preset->SMOOTHING = value;
+    POT.setAdaptive(preset->SMOOTHING, preset->RESPONSE);
+}
+
+/**
+ * @brief Sets how fast the adaptive smoothing opens up on pedal movement (`pedalResponse`).
+ *
+ * @param value 0 (smoothing stays fixed) - 127 (opens up on the slightest movement).
+ */
+void configResponse(byte value)
+{
+    preset->RESPONSE = value;
+    POT.setAdaptive(preset->SMOOTHING, preset->RESPONSE);
+}
+
+/**
+ * @brief Calibrates the travel of the expression pedal (`pedalCalibrate`).
+ *
+ * @param value 64-127 starts recording, sweep the pedal heel to toe, 0-63 stops.
+ *
+ * @details The LED is lit while recording. On stop the recorded travel is taken and saved with
+ *          the configuration when it covers at least `ATPOT_MIN_TRAVEL` steps, otherwise the
+ *          current travel stays.
+ */
+void configCalibrate(byte value)
+{
+    if (value >= 64) {
+        POT.beginCalibration();
+        digitalWrite(blinker, HIGH);
+        return;
+    }
+    digitalWrite(blinker, LOW);
+    if (POT.endCalibration()) {
+        STATE.TRAVEL_LOW = POT.getTravelLow();
+        STATE.TRAVEL_HIGH = POT.getTravelHigh();
+        saveConfig();
+    }
+}
+
+/**
+ * @brief Selects the output ports of the expression and sustain pedals (`pedalPorts`).
+ *
+ * @param value 1 USB, 2 DIN, 3 both, other values select USB.
+ */
+void configPorts(byte value)
+{
+    preset->PORTS = value >= 1 && value <= 3 ? value : ATROUTE_USB;
+    applyRoutes();
+}
+
+/**
+ * @brief Captures a raw trace of the expression pedal (`pedalCapture`).
+ *
+ * @param value 1-63 starts recording now, 65-127 once the pedal moves by `captureTrigger`, keeping
+ *              every n-th sample (n = value & 63). 0 and 64 stop.
+ *
+ * @details The trace fills `TRACE` until it is full, stopped, or exported with `sysexCapture`.
+ *          The pedal does not go idle meanwhile, that would change the sample rate.
+ */
+void configCapture(byte value)
+{
+    byte every = value & 0x3F;
+    if (!every) {
+        TRACE.stop();
+        POT.setTrace(nullptr);
+        return;
+    }
+    capturePeriod = ATADC::isRunning(POT.getPin()) ? ATADC::period() : scanBudgetUS;
+    if (value & 0x40) {
+        TRACE.arm(every, captureTrigger);
+    } else {
+        TRACE.start(every);
+    }
+    POT.setTrace(&TRACE);
+    markActive();
+}
+
+/**
+ * @brief Configuration CC handlers, indexed by CC number - `setEXP`, kept in flash.
+ */
+void (*const CONFIG_HANDLERS[])(byte) PROGMEM = {
+    configExpressionCC, // setEXP
+    configSustainCC, // setSustain
+    configReset, // pedalReset
+    configSave, // pedalSave
+    configLoad, // pedalLoad
+    configDeadZone, // pedalDeadZone
+    configExpressionChannel, // pedalExpCh
+    configSustainChannel, // pedalSustainCh
+    configResolution, // pedalHiRes
+    configRate, // pedalRate
+    configCurve, // pedalCurve
+    configSmoothing, // pedalSmoothing
+    configResponse, // pedalResponse
+    configCalibrate, // pedalCalibrate
+    configPorts, // pedalPorts
+    configCapture, // pedalCapture
+};
+static_assert(sizeof(CONFIG_HANDLERS) / sizeof(CONFIG_HANDLERS[0]) == pedalCapture - setEXP + 1,
+    "one handler per configuration CC");
 
 /**
  * @brief Handles incoming MIDI messages to configure the pedal.
  *
- * @details This function processes MIDI Control Change messages to:
+ * @details Processes every message that is waiting, until none is left or `midiBudgetUS` has been
+ *          spent, so a burst of configuration messages or host traffic does not back up. Channel
+ *          messages for other channels than `configChannel` are skipped by `MIDIIN`, they do not end
+ *          the pass. Clock and other message types the pedal does not use are dropped after the type
+ *          check. Every message
+ *          is timestamped when it is read, and a `sysexPing` is answered right there, before the other
+ *          SysEx commands are even parsed.
+ *          Control Change messages 33-48 are routed through `CONFIG_HANDLERS` to:
  *          - Set the CC number for the expression pedal.
  *          - Set the CC number for the sustain pedal.
  *          - Reset the pedal to default settings.
@@ -167,177 +730,820 @@ ATPOT POT(pEXP, 0, 127, DEADZONE, expressionChanged);
  *          - Set the dead zone for the expression pedal.
  *          - Set the MIDI channel for the expression pedal.
  *          - Set the MIDI channel for the sustain pedal.
+ *          - Select 7 bit or 14 bit resolution for the expression pedal.
+ *          - Set the message rate limit for the expression pedal.
+ *          - Select the response curve of the expression pedal.
+ *          - Set the adaptive smoothing of the expression pedal and its response to movement.
+ *          - Calibrate the travel of the expression pedal.
+ *          - Select the output ports (USB, DIN or both).
+ *          - Capture a raw trace of the expression pedal.
+ *          Program Change messages select a preset. The settings above change the active preset.
  */
 void handleMidiInput()
 {
-    if (!MIDI.read())
-        return;
-
-    if (MIDI.getType() != midi::ControlChange)
-        return;
+    unsigned long start = micros();
+    while (MIDIIN.read()) {
+        unsigned long receivedAt = micros();
+        markActive();
+        switch (MIDI.getType()) {
+        case midi::ControlChange: {
+            byte cc = MIDI.getData1() - setEXP; // wraps for CCs below setEXP
+            if (cc <= pedalCapture - setEXP) {
+                void (*handler)(byte) = (void (*)(byte))pgm_read_ptr(&CONFIG_HANDLERS[cc]);
+                handler(MIDI.getData2());
+            }
+            break;
+        }
+        case midi::ProgramChange:
+            if (MIDI.getData1() < presetCount)
+                selectPreset(MIDI.getData1());
+            break;
+        case midi::SystemExclusive:
+            if (ATSYSEX::command(MIDI.getSysExArray(), MIDI.getSysExArrayLength()) == sysexPing) {
+                sendPong(MIDI.getSysExArray(), MIDI.getSysExArrayLength(), receivedAt);
+                break;
+            }
+            handleSysEx(MIDI.getSysExArray(), MIDI.getSysExArrayLength());
+            break;
+        default:
+            break; // clock, notes and the rest are not for the pedal
+        }
+        if ((micros() - start) >= midiBudgetUS)
+            return; // the rest waits for the next pass
+    }
+}
 
-    byte data = constrain(MIDI.getData2(), setLOW, setHIGH);
+/**
+ * @brief Handles incoming SysEx messages addressed to the pedal.
+ *
+ * @param data The received message, including F0 and F7.
+ * @param length The length of the received message.
+ *
+ * @details Messages for other devices are ignored. See `sysexStats` and `sysexConfigRequest` ...
+ *          `sysexConfigLoad`, `sysexRouteRequest`, `sysexRouteLoad`, `sysexBenchStart`, `sysexBootloader`, `sysexProfile` and `sysexCapture` for the supported commands.
+ */
+void handleSysEx(const byte* data, unsigned length)
+{
+    int command = ATSYSEX::command(data, length);
 
-    if (MIDI.getData1() == setEXP) {
-        ECC = data;
+    if (command == sysexStats) {
+        sendStats(length > 5 && data[4] == 1);
         return;
     }
-    if (MIDI.getData1() == setSustain) {
-        SCC = data;
+    if (command == sysexConfigRequest) {
+        sendConfig();
         return;
     }
-    if (MIDI.getData1() == pedalReset) {
-        if (data % 2 == 0)
-            initPedal();
+    if (command == sysexConfigLoad) {
+        byte status = receiveConfig(data + 4, length - 5);
+        ATSYSEX ack(sysexConfigAck);
+        ack.put7(status);
+        MIDI.sendSysEx(ack.length(), ack.data(), false);
         return;
     }
-    if (MIDI.getData1() == pedalSave && MIDI.getData2() == 127) {
-        saveConfig();
+    if (command == sysexRouteRequest && length > 5) {
+        sendRoute(data[4]);
         return;
     }
-    if (MIDI.getData1() == pedalLoad && MIDI.getData2() == 127) {
-        loadConfig();
+    if (command == sysexBootloader) {
+        if (length > 8 && memcmp(data + 4, "BOOT", 4) == 0) {
+            enterBootloader();
+        }
+        return;
+    }
+    if (command == sysexCapture) {
+        sendCapture();
+        return;
+    }
+    if (command == sysexProfile) {
+        if (length > 5 && data[4] == 1) {
+            startProfile(true);
+        } else {
+            sendProfile(STATE.READINGS ? profileOK : profileNone);
+        }
+        return;
+    }
+    if (command == sysexBenchStart) {
+        if (length > 6) {
+            startBench(data[4], data[5]);
+        }
+        return;
+    }
+    if (command == sysexRouteLoad) {
+        byte status = receiveRoute(data + 4, length - 5);
+        ATSYSEX ack(sysexConfigAck);
+        ack.put7(status);
+        MIDI.sendSysEx(ack.length(), ack.data(), false);
+        return;
+    }
+}
+
+/**
+ * @brief Starts a noise profile of the expression pedal.
+ *
+ * @param report true to send the result with `sysexProfileReport` when done.
+ *
+ * @details Every raw sample of the next `profileMS` goes into `NOISE`, the pedal keeps working as
+ *          usual. `housekeepingTask()` then calls `finishProfile()`, off the scan path. Answers
+ *          `profileBusy` when a profile runs.
+ */
+void startProfile(bool report)
+{
+    if (profiling) {
+        if (report) {
+            sendProfile(profileBusy);
+        }
+        return;
+    }
+    NOISE.reset();
+    POT.setProfile(&NOISE);
+    profileReport = report;
+    profileStartedAt = millis();
+    profiling = true;
+    markActive();
+}
+
+/**
+ * @brief Ends the noise profile and applies the filter it picked.
+ *
+ * @details When the pedal stayed at rest (`ATPOTNOISE::atRest()`) the shortest window and lowest
+ *          threshold that keep it quiet go into `STATE`, are applied and saved. Otherwise the
+ *          previous filter stays.
+ */
+void finishProfile()
+{
+    profiling = false;
+    POT.setProfile(nullptr);
+
+    byte status = profileMoved;
+    if (NOISE.atRest()) {
+        NOISE.tune(STATE.READINGS, STATE.THRESHOLD);
+        STATE.NOISE_SPREAD = NOISE.spread();
+        STATE.NOISE_DEVIATION = NOISE.deviation();
+        applyFilter();
+        saveConfig();
+        status = profileOK;
+    }
+    if (profileReport) {
+        sendProfile(status);
+    }
+}
+
+/**
+ * @brief Sends the stored noise profile.
+ *
+ * @param status `profileOK` ... `profileNone`.
+ *
+ * @details `F0 7D 41 61 <status> <readings> <threshold> <spread> <deviation> F7`, the window and
+ *          threshold in use (0 readings before the first profile), the spread in 10 bit steps and
+ *          the standard deviation in 1/16 steps as a 16 bit value.
+ */
+void sendProfile(byte status)
+{
+    ATSYSEX report(sysexProfileReport);
+    report.put7(status);
+    report.put7(STATE.READINGS);
+    report.put7(STATE.THRESHOLD);
+    report.put7(STATE.NOISE_SPREAD);
+    report.put16(STATE.NOISE_DEVIATION);
+    MIDI.sendSysEx(report.length(), report.data(), false);
+}
+
+/**
+ * @brief Exports the raw trace of the expression pedal, a running capture ends here.
+ *
+ * @details Sends `F0 7D 41 71 <state> <every> <period> <samples> <bytes> <started> F7`, the trace
+ *          state before the export (`ATTRACE_STOPPED` ... `ATTRACE_FULL`), the n of `pedalCapture`,
+ *          the source sample period (us), the sample and byte counts as 16 bit values and the
+ *          time of the first sample (micros, 32 bit). Then the trace follows in
+ *          `F0 7D 41 72 <offset> <data> F7` chunks, the byte offset as a 16 bit value and up to
+ *          `captureChunkBytes` bytes packed 7 into 8 (`ATSYSEX::putPacked()`).
+ *          `ATTRACE::decode()` turns the data back into samples.
+ */
+void sendCapture()
+{
+    byte state = TRACE.state();
+    TRACE.stop();
+    POT.setTrace(nullptr);
+
+    ATSYSEX header(sysexCaptureHeader);
+    header.put7(state);
+    header.put7(TRACE.every());
+    header.put16(capturePeriod);
+    header.put16(TRACE.samples());
+    header.put16(TRACE.length());
+    header.put32(TRACE.startedAt);
+    MIDI.sendSysEx(header.length(), header.data(), false);
+
+    for (uint16_t offset = 0; offset < TRACE.length(); offset += captureChunkBytes) {
+        ATSYSEX chunk(sysexCaptureChunk);
+        chunk.put16(offset);
+        chunk.putPacked(TRACE.data() + offset, min(TRACE.length() - offset, captureChunkBytes));
+        MIDI.sendSysEx(chunk.length(), chunk.data(), false);
+    }
+}
+
+/**
+ * @brief Applies the filter of the noise profile, or the defaults before the first profile.
+ */
+void applyFilter()
+{
+    POT.setNumReadings(STATE.READINGS ? STATE.READINGS : defaultReadings);
+    POT.setDebounceThreshold(STATE.READINGS ? STATE.THRESHOLD : defaultThreshold);
+}
+
+/**
+ * @brief Restarts the pedal into the bootloader (`sysexBootloader`).
+ *
+ * @details Does what the 1200 bps touch of the serial port does, for hosts that can only send MIDI:
+ *          acknowledges with `F0 7D 41 23 00 F7`, sets the boot key and lets the watchdog reset the
+ *          chip, with interrupts off so nothing overwrites the key. The bootloader then waits
+ *          `REQUEST_TIMEOUT_PERIOD` (8 s) for the upload instead of starting the sketch again.
+ */
+void enterBootloader()
+{
+    ATSYSEX ack(sysexConfigAck);
+    ack.put7(configOK);
+    MIDI.sendSysEx(ack.length(), ack.data(), false);
+    delay(20); // the host fetches the acknowledgement
+
+    noInterrupts();
+    *(volatile uint16_t*)bootKeyAddress = bootKey;
+    wdt_enable(WDTO_15MS);
+    while (true) { }
+}
+
+/**
+ * @brief Answers a `sysexPing`.
+ *
+ * @param data The received message, including F0 and F7.
+ * @param length The length of the received message.
+ * @param receivedAt The time the message was read (micros).
+ *
+ * @details `F0 7D 41 41 <token> <received> <sustain latency mean> <sustain latency max> <scan mean>
+ *          <scan max> <sent> F7`: the first `pingTokenSize` bytes of the ping, the pedal's receive
+ *          time, the sustain edge to message latency and the pedal scan time from `STATS` (16 bit) and
+ *          the send time, taken last (32 bit, micros). The host gets the round trip from its own clock,
+ *          and the time the pedal held the ping from the two timestamps.
+ */
+void sendPong(const byte* data, unsigned length, unsigned long receivedAt)
+{
+    ATSYSEX reply(sysexPong);
+    for (unsigned i = 4; i + 1 < length && i < 4 + pingTokenSize; i++) {
+        reply.put7(data[i]);
+    }
+    reply.put32(receivedAt);
+    reply.put16(STATS[statLatency].mean());
+    reply.put16(STATS[statLatency].maximum);
+    reply.put16(STATS[statScan].mean());
+    reply.put16(STATS[statScan].maximum);
+    reply.put32(micros());
+    MIDI.sendSysEx(reply.length(), reply.data(), false);
+}
+
+/**
+ * @brief Sends one extra destination of the active preset.
+ *
+ * @param number The destination (1 - `extraRoutes`), others are ignored.
+ *
+ * @details `F0 7D 41 25 <route> <CC> <channel> <curve> <ports> F7`.
+ */
+void sendRoute(byte number)
+{
+    if (number < 1 || number > extraRoutes) {
         return;
     }
-    if (MIDI.getData1() == pedalDeadZone) {
-        POT.setDeadZone((float)constrain(MIDI.getData2(), 1, 50));
+    const ATROUTE& R = preset->ROUTES[number - 1];
+    ATSYSEX message(sysexRouteDump);
+    message.put7(number);
+    message.put7(R.cc);
+    message.put7(R.ch);
+    message.put7(R.curve);
+    message.put7(R.ports);
+    MIDI.sendSysEx(message.length(), message.data(), false);
+}
+
+/**
+ * @brief Sets one extra destination of the active preset from `sysexRouteLoad`.
+ *
+ * @param data The payload: route (1 - `extraRoutes`), CC, channel, curve and ports, optionally followed by 01 to save.
+ * @param length The length of the payload.
+ * @return `configOK`, or the reason the destination was rejected.
+ *
+ * @details Ports 0 (or CC 0) disables the destination.
+ */
+byte receiveRoute(const byte* data, unsigned length)
+{
+    if (length < sysexRouteSize) {
+        return configBadVersion;
+    }
+    byte number = data[0];
+    ATROUTE R = { data[1], data[2], data[3], data[4] };
+    if (number < 1 || number > extraRoutes || R.cc > setHIGH || R.ch < 1 || R.ch > 16 || R.curve >= ATPOT_CURVE_COUNT
+        || R.ports > (ATROUTE_USB | ATROUTE_DIN)) {
+        return configBadValue;
+    }
+
+    preset->ROUTES[number - 1] = R;
+    applyRoutes();
+    if (length > sysexRouteSize && data[sysexRouteSize] == 1) {
+        saveConfig();
+    }
+    return configOK;
+}
+
+/**
+ * @brief Sends the configuration of the active preset as one SysEx message.
+ *
+ * @details `F0 7D 41 21 <version> <ECC> <SCC> <expression channel> <sustain channel> <dead zone>
+ *          <resolution> <rate> <curve> <smoothing> <response> <ports> <checksum> F7`, with the dead zone in tenths of a percent
+ *          as a 16 bit value and the checksum making the 7 bit sum of version ... checksum zero.
+ */
+void sendConfig()
+{
+    const PRESET& P = *preset;
+
+    ATSYSEX message(sysexConfigDump);
+    message.put7(sysexConfigVersion);
+    message.put7(P.ECC);
+    message.put7(P.SCC);
+    message.put7(P.CH_EXPRESSION);
+    message.put7(P.CH_SUSTAIN);
+    message.put16(P.DEADZONE);
+    message.put7(P.HIRES);
+    message.put7(P.RATE);
+    message.put7(P.CURVE);
+    message.put7(P.SMOOTHING);
+    message.put7(P.RESPONSE);
+    message.put7(P.PORTS);
+    message.putChecksum();
+    MIDI.sendSysEx(message.length(), message.data(), false);
+}
+
+/**
+ * @brief Applies a configuration received with `sysexConfigLoad` to the active preset.
+ *
+ * @param data The payload, in the layout of `sendConfig()`, optionally followed by 01 to save it.
+ * @param length The length of the payload.
+ * @return `configOK`, or the reason the configuration was rejected.
+ *
+ * @details Every field is checked before anything is changed, so a configuration is either applied
+ *          completely or not at all.
+ */
+byte receiveConfig(const byte* data, unsigned length)
+{
+    if (length < sysexConfigSize || data[0] != sysexConfigVersion) {
+        return configBadVersion;
+    }
+    if (ATSYSEX::checksum(data, sysexConfigSize) != 0) {
+        return configBadChecksum;
+    }
+
+    PRESET P;
+    P.ECC = data[1];
+    P.SCC = data[2];
+    P.CH_EXPRESSION = data[3];
+    P.CH_SUSTAIN = data[4];
+    uint16_t deadZone = ATSYSEX::get16(data + 5);
+    P.DEADZONE = deadZone;
+    P.HIRES = data[8];
+    P.RATE = data[9];
+    P.CURVE = data[10];
+    P.SMOOTHING = data[11];
+    P.RESPONSE = data[12];
+    P.PORTS = data[13];
+    memcpy(P.ROUTES, preset->ROUTES, sizeof(P.ROUTES)); // set with `sysexRouteLoad`
+
+    if (P.ECC > setHIGH || P.SCC > setHIGH || P.CH_EXPRESSION < 1 || P.CH_EXPRESSION > 16 || P.CH_SUSTAIN < 1
+        || P.CH_SUSTAIN > 16 || deadZone > 500 || data[8] > 1 || P.CURVE >= ATPOT_CURVE_COUNT
+        || P.SMOOTHING > 127 || P.RESPONSE > 127
+        || P.PORTS < 1 || P.PORTS > 3) {
+        return configBadValue;
+    }
+
+    *preset = P;
+    applyPreset();
+    if (length > sysexConfigSize && data[sysexConfigSize] == 1) {
+        saveConfig();
+    }
+    return configOK;
+}
+
+
+/**
+ * @brief Sends the timing statistics and output counters as SysEx.
+ *
+ * @param reset true to clear the statistics and counters after sending them.
+ *
+ * @details Sends one `sysexStats` message per stage:
+ *          `F0 7D 41 10 <stage> <min> <max> <mean> <count> <histogram x 8> <overruns> F7`
+ *          with min/max/mean/histogram as 16 bit and count/overruns as 32 bit values, then one
+ *          `sysexCounters` message with the number of CC messages sent and suppressed
+ *          by the output stage and the number of USB transfers and packets written:
+ *          `F0 7D 41 11 <sent> <suppressed> <transfers> <packets> <DIN sent> <DIN coalesced> <DIN dropped> F7`
+ *          (32 bit values).
+ */
+void sendStats(bool reset)
+{
+    for (byte i = 0; i < statCount; i++) {
+        ATSYSEX message(sysexStats);
+        message.put7(i);
+        message.put16(STATS[i].minimum);
+        message.put16(STATS[i].maximum);
+        message.put16(STATS[i].mean());
+        message.put32(STATS[i].count);
+        for (byte b = 0; b < ATSTAT_BUCKETS; b++) {
+            message.put16(STATS[i].histogram[b]);
+        }
+        message.put32(STATS[i].overruns);
+        MIDI.sendSysEx(message.length(), message.data(), false);
+        if (reset) {
+            STATS[i].reset();
+        }
+    }
+
+    ATSYSEX counters(sysexCounters);
+    counters.put32(OUT.sentCount);
+    counters.put32(OUT.suppressedCount);
+    counters.put32(PACKETS.transferCount);
+    counters.put32(PACKETS.packetCount);
+    counters.put32(DIN.sentCount);
+    counters.put32(DIN.coalescedCount);
+    counters.put32(DIN.droppedCount);
+    MIDI.sendSysEx(counters.length(), counters.data(), false);
+    if (reset) {
+        resetCounters();
+    }
+}
+
+/**
+ * @brief Clears the message counters of the output stages.
+ */
+void resetCounters()
+{
+    OUT.sentCount = 0;
+    OUT.suppressedCount = 0;
+    PACKETS.transferCount = 0;
+    PACKETS.packetCount = 0;
+    DIN.sentCount = 0;
+    DIN.coalescedCount = 0;
+    DIN.droppedCount = 0;
+    DIN.runningCount = 0;
+}
+
+/**
+ * @brief Starts, or stops, the on-device benchmark (`sysexBenchStart`).
+ *
+ * @param pattern `benchSweep` or `benchNoise` to start, 0 to stop a running benchmark early.
+ * @param seconds The length of the run (1 - `benchMaxSeconds`).
+ *
+ * @details Clears the statistics and counters, then feeds the generated readings into the
+ *          expression pedal in place of the pin (`ATPOT::setSampler()`) and scans it on every loop
+ *          pass, as fast as the loop runs. The values go out on the active preset's destinations,
+ *          through its rate limit, so set `pedalRate` to 0 to measure the transport itself.
+ *          The results are sent by `finishBench()`.
+ */
+void startBench(byte pattern, byte seconds)
+{
+    if (pattern != benchSweep && pattern != benchNoise) {
+        if (benchPattern) {
+            finishBench();
+        }
         return;
     }
-    if (MIDI.getData1() == pedalExpCh) {
-        expCH = constrain(MIDI.getData2(), 1, 16);
+
+    for (byte i = 0; i < statCount; i++) {
+        STATS[i].reset();
+    }
+    resetCounters();
+    benchPattern = pattern;
+    benchLength = constrain(seconds, 1, benchMaxSeconds) * 1000UL;
+    benchScans = 0;
+    benchStartedAt = millis();
+    POT.setSampler(benchSample);
+}
+
+/**
+ * @brief Generates one reading of the running benchmark pattern.
+ *
+ * @return The raw reading (0 - `MAX_ANALOG_POT_READING`).
+ *
+ * @details The sweep moves `benchSweepStep` per scan heel to toe and back, the noise is a 16 bit
+ *          xorshift, so nearly every scan changes the value.
+ */
+int benchSample()
+{
+    static int reading = 0;
+    static int step = benchSweepStep;
+    static uint16_t noise = 0xACE1;
+
+    if (benchPattern == benchNoise) {
+        noise ^= noise << 7;
+        noise ^= noise >> 9;
+        noise ^= noise << 8;
+        return noise & MAX_ANALOG_POT_READING;
+    }
+
+    reading += step;
+    if (reading <= 0 || reading >= MAX_ANALOG_POT_READING) {
+        reading = constrain(reading, 0, MAX_ANALOG_POT_READING);
+        step = -step;
+    }
+    return reading;
+}
+
+/**
+ * @brief Scheduler task running the benchmark scans, on every pass.
+ *
+ * @details Does nothing while no benchmark runs, otherwise scans the pedal once more and ends the
+ *          run when its time is over.
+ */
+void benchTask()
+{
+    if (!benchPattern) {
         return;
     }
-    if (MIDI.getData1() == pedalSustainCh) {
-        sustainCH = constrain(MIDI.getData2(), 1, 16);
+    if ((millis() - benchStartedAt) >= benchLength) {
+        finishBench();
         return;
     }
+    scanTask();
+    benchScans++;
+}
+
+/**
+ * @brief Computes a rate per second without overflowing on long runs.
+ *
+ * @param count The number of events.
+ * @param ms The time they took (ms, not 0).
+ * @return The events per second.
+ */
+unsigned long perSecond(unsigned long count, unsigned long ms)
+{
+    return count / ms * 1000 + count % ms * 1000 / ms;
+}
+
+/**
+ * @brief Ends the benchmark and sends its results.
+ *
+ * @details Gives the pin back to the pedal, whose real position is sent again on the next scan, and
+ *          sends `F0 7D 41 31 <pattern> <ms> <scans> <USB packets/s> <DIN messages/s> <suppressed>
+ *          <DIN coalesced> <USB transfers> <loop p50> <loop p90> <loop p99> <loop max> F7`, with the
+ *          loop period percentiles (upper bucket limits of `STATS[statLoop]`, in microseconds) as 16 bit and the
+ *          rest as 32 bit values. `sysexStats` still has the full statistics of the run.
+ */
+void finishBench()
+{
+    unsigned long elapsed = max(millis() - benchStartedAt, 1UL);
+    byte pattern = benchPattern;
+    benchPattern = 0;
+    POT.setSampler(nullptr);
+    ROUTER.refresh();
+
+    ATSYSEX report(sysexBenchReport);
+    report.put7(pattern);
+    report.put32(elapsed);
+    report.put32(benchScans);
+    report.put32(perSecond(PACKETS.packetCount, elapsed));
+    report.put32(perSecond(DIN.sentCount, elapsed));
+    report.put32(OUT.suppressedCount);
+    report.put32(DIN.coalescedCount);
+    report.put32(PACKETS.transferCount);
+    report.put16(STATS[statLoop].percentile(50));
+    report.put16(STATS[statLoop].percentile(90));
+    report.put16(STATS[statLoop].percentile(99));
+    report.put16(STATS[statLoop].maximum);
+    MIDI.sendSysEx(report.length(), report.data(), false);
 }
 
 /**
  * @brief Initializes the pedal to its default settings.
  *
- * @details This function resets the expression and sustain pedal CC numbers, MIDI channels, and the dead zone to their default values.
+ * @details This function resets the expression and sustain pedal CC numbers, MIDI channels, the dead zone, the resolution, the rate limit, the response curve, the smoothing and the destinations of every preset to their default values, forgets the calibrated travel and the noise profile, and selects preset 0.
  */
 void initPedal()
 {
-    ECC = EXP_CC;
-    SCC = SUSTAIN_CC;
-    expCH = MIDI_CH;
-    sustainCH = MIDI_CH;
-    POT.setDeadZone(DEADZONE);
+    for (byte i = 0; i < presetCount; i++) {
+        defaultPreset(STATE.PRESETS[i]);
+    }
+    STATE.TRAVEL_LOW = 0;
+    STATE.TRAVEL_HIGH = MAX_ANALOG_POT_READING;
+    STATE.READINGS = 0;
+    STATE.THRESHOLD = defaultThreshold;
+    STATE.NOISE_SPREAD = 0;
+    STATE.NOISE_DEVIATION = 0;
+    strcpy(STATE.ID, ID);
+    applyFilter();
+    selectPreset(0);
+}
+
+/**
+ * @brief Fills a preset with the default settings.
+ *
+ * @param P The preset to fill.
+ */
+void defaultPreset(PRESET& P)
+{
+    P.ECC = EXP_CC;
+    P.SCC = SUSTAIN_CC;
+    P.CH_EXPRESSION = MIDI_CH;
+    P.CH_SUSTAIN = MIDI_CH;
+    P.DEADZONE = DEADZONE;
+    P.HIRES = HIRES;
+    P.RATE = RATE;
+    P.CURVE = CURVE;
+    P.SMOOTHING = SMOOTHING;
+    P.RESPONSE = RESPONSE;
+    P.PORTS = PORTS;
+    for (byte i = 0; i < extraRoutes; i++) {
+        P.ROUTES[i] = { 0, MIDI_CH, ATPOT_CURVE_LINEAR, 0 };
+    }
+}
+
+/**
+ * @brief Makes a preset the active one.
+ *
+ * @param number The preset (0 - `presetCount` - 1).
+ *
+ * @details Only moves the `preset` pointer and applies the settings to the pot and the output stage,
+ *          the presets are already in RAM. The pedal's current position is sent again on the new
+ *          preset's CC on the next scan.
+ */
+void selectPreset(byte number)
+{
+    STATE.ACTIVE = number;
+    preset = &STATE.PRESETS[number];
+    applyPreset();
+    ROUTER.refresh();
+}
+
+/**
+ * @brief Applies the settings of the active preset to the pot, the router and the output stage.
+ *
+ * @details The calibrated travel belongs to the pedal rather than to a preset and is applied first.
+ */
+void applyPreset()
+{
+    POT.setTravel(STATE.TRAVEL_LOW, STATE.TRAVEL_HIGH);
+    POT.setDeadZoneTenths(preset->DEADZONE);
+    POT.setHighResolution(preset->HIRES);
+    ROUTER.setHighResolution(preset->HIRES);
+    OUT.setRate(preset->RATE * 10);
+    POT.setAdaptive(preset->SMOOTHING, preset->RESPONSE);
+    applyRoutes();
+}
+
+/**
+ * @brief Hands the destinations of the active preset to the router.
+ *
+ * @details Route 0 is the main destination (`ECC`, `CH_EXPRESSION`, `CURVE` on `PORTS`), the
+ *          extra destinations follow. The curves are applied per destination by the router, the
+ *          pot itself stays linear.
+ */
+void applyRoutes()
+{
+    ROUTER.setRoute(0, { preset->ECC, preset->CH_EXPRESSION, preset->CURVE, preset->PORTS });
+    for (byte i = 0; i < extraRoutes; i++) {
+        ROUTER.setRoute(i + 1, preset->ROUTES[i]);
+    }
 }
 
 /**
  * @brief Saves the current pedal configuration to EEPROM.
  *
- * @details Stores the expression pedal CC number, sustain pedal CC number, MIDI channels, dead zone, and board identifier in EEPROM.
+ * @details Stores all the presets (expression pedal CC number, sustain pedal CC number, MIDI channels, dead zone, resolution, rate limit, response curve, adaptive smoothing, output ports and destinations), the active preset, the expression pedal travel, and board identifier in EEPROM.
+ *          Each save goes to the next slot of `STORE`, and saving an unchanged configuration writes nothing.
+ *          Only queues the save, `housekeepingTask()` writes it a byte at a time, so the MIDI handlers
+ *          and the scan never wait for the EEPROM. Saving again before it is done restarts the write
+ *          with the current `STATE`.
  */
 void saveConfig()
 {
-    PEDALSTATE P;
-    P.ECC = ECC;
-    P.SCC = SCC;
-    P.CH_EXPRESSION = expCH;
-    P.CH_SUSTAIN = sustainCH;
-    P.DEADZONE = POT.getDeadZone();
-    strcpy(P.ID, ID);
-    EEPROM.put(0, P);
+    STORE.queue(&STATE);
     if (DEBUG) {
-        Serial.println("Config saved");
+        Serial.println("Config save queued");
     }
 }
 
 /**
  * @brief Loads the pedal configuration from EEPROM.
  *
- * @details Retrieves the expression pedal CC number, sustain pedal CC number, MIDI channels, dead zone, and board identifier from EEPROM. If no valid configuration is found, it sets the default values and saves them.
+ * @details Retrieves all the presets, the active preset, and board identifier from EEPROM into `STATE`. If no valid configuration is found, it sets the default values and saves them.
+ *          `STORE` only returns a record with the current `configLayout` and a matching CRC.
  */
 void loadConfig()
 {
-    PEDALSTATE PS;
-    EEPROM.get(0, PS);
-
-    if (String(PS.ID) != String(ID)) { // eeprom does not contain initial state
-        PS.ECC = EXP_CC;
-        PS.SCC = SUSTAIN_CC;
-        PS.CH_EXPRESSION = MIDI_CH;
-        PS.CH_SUSTAIN = MIDI_CH;
-        PS.DEADZONE = DEADZONE;
-        strcpy(PS.ID, ID);
-        EEPROM.put(0, PS);
+    if (!STORE.load(&STATE) || strncmp(STATE.ID, ID, sizeof(ID)) != 0) { // eeprom does not contain initial state
+        initPedal();
+        saveConfig();
         if (DEBUG) {
             Serial.println("Config Initialized to EEPROM");
         }
     }
 
-    ECC = PS.ECC;
-    SCC = PS.SCC;
-    expCH = PS.CH_EXPRESSION;
-    sustainCH = PS.CH_SUSTAIN;
-    POT.setDeadZone(PS.DEADZONE);
+    selectPreset(STATE.ACTIVE < presetCount ? STATE.ACTIVE : 0);
+    applyFilter();
     if (DEBUG) {
         Serial.println("Config Loaded from EEPROM");
     }
 }
 
+/**
+ * @brief Interrupt handler for the sustain pedal pin (INT1, pin 2).
+ *
+ * @details Runs on every edge of the pin and reads the level the pin has now. The first change of the
+ *          level after a quiet period goes into `EVENTS` with its capture time, edges within
+ *          `debounceMS` of it are contact bounce and ignored, and so is an edge that leaves the pin at
+ *          the level already queued (a bounce that settled before the read). A pin read, a few
+ *          compares and one queue push, the sending happens in `handleSustain()`.
+ */
+void sustainEdge()
+{
+    unsigned long now = micros();
+    byte level = digitalRead(pSUSTAIN);
+    if (level == sustainLevel || (now - sustainEdgeAt) < debounceMS * 1000UL) {
+        return;
+    }
+    sustainEdgeAt = now;
+    EVENTS.push({ sourceSustain, level, sustainLevel, now });
+    sustainLevel = level;
+}
+
 /**
  * @brief Handles the sustain pedal input.
  *
- * @details Reads the state of the sustain pedal and sends a MIDI CC message when the state changes. Implements debouncing to prevent spurious readings.
+ * @details Sends the edges queued by `sustainEdge()` one per pass, so a press is not delayed by the
+ *          debounce time and a quick press and release are both sent. The time from the captured edge to
+ *          the queued message goes into `STATS[statLatency]`. Once the debounce window after the last
+ *          edge is over the pin is read once, so a release that happened inside the window (or a
+ *          spurious edge) is corrected.
  */
 void handleSustain()
 {
-    unsigned long now = millis();
-    if ((now - lastScan) < debounceMS) {
+    ATEVENT event;
+    if (EVENTS.pop(event)) {
+        markActive();
+        sendSustain(event.value);
+        STATS[statLatency].record(micros() - event.at);
+        sustainVerifyAt = event.at;
+        sustainVerify = true;
+        return;
+    }
+
+    if (!sustainVerify || (micros() - sustainVerifyAt) < debounceMS * 1000UL) {
         return;
     }
 
+    sustainVerify = false;
     byte state = digitalRead(pSUSTAIN);
-    lastScan = now;
     if (state != lastState) {
-        if (SCC) {
-            MIDI.sendControlChange(SCC, state == 1 ? 127 : 0, sustainCH);
-            if (DEBUG) {
-                Serial.print("Sent Sustain Message with CC: ");
-                Serial.print(SCC);
-                Serial.print(" Value: ");
-                Serial.print(state == 1 ? 127 : 0);
-                Serial.print(" on Channel: ");
-                Serial.println(sustainCH);
-            }
-        } else {
-        }
-        lastState = state;
+        sustainLevel = state; // the next edge is compared with the corrected state
+        sendSustain(state);
     }
 }
 
 /**
- * @brief Callback function for expression pedal changes.
+ * @brief Sends the sustain pedal state.
  *
- * @param newValue The new value of the expression pedal (0-127).
- * @param oldValue The old value of the expression pedal (0-127).
+ * @param state The new state of the sustain pedal (HIGH or LOW).
  */
-void expressionChanged(byte newValue, byte oldValue)
+void sendSustain(byte state)
 {
-    if (!ECC)
-        return;
-    MIDI.sendControlChange(ECC, newValue, expCH);
-    if (DEBUG) {
-        Serial.print("Sent Expression Message with CC: ");
-        Serial.print(ECC);
-        Serial.print(" Value: ");
-        Serial.print(newValue);
-        Serial.print(" on Channel: ");
-        Serial.print(expCH);
-        Serial.print(" OldValue: ");
-        Serial.println(oldValue);
+    if (preset->SCC) {
+        if (preset->PORTS & ATROUTE_USB)
+            PACKETS.controlChange(preset->SCC, state == 1 ? 127 : 0, preset->CH_SUSTAIN);
+        if (preset->PORTS & ATROUTE_DIN)
+            DIN.switchChange(preset->SCC, state == 1 ? 127 : 0, preset->CH_SUSTAIN); // never coalesced
+        if (DEBUG) {
+            Serial.print("Sent Sustain Message with CC: ");
+            Serial.print(preset->SCC);
+            Serial.print(" Value: ");
+            Serial.print(state == 1 ? 127 : 0);
+            Serial.print(" on Channel: ");
+            Serial.println(preset->CH_SUSTAIN);
+        }
     }
+    lastState = state;
+}
+
+/**
+ * @brief Puts one Control Change message on the USB MIDI transport.
+ *
+ * @param cc The MIDI CC number.
+ * @param value The CC value (0-127).
+ * @param ch The MIDI channel (1-16).
+ *
+ * @details The message is buffered in `PACKETS` and written with the other messages of the loop pass.
+ */
+void sendCC(byte cc, byte value, byte ch)
+{
+    PACKETS.controlChange(cc, value, ch);
 }
 
 /**
  * @brief Arduino setup function.
  *
- * @details Initializes pin modes, serial communication, MIDI, and loads the configuration from EEPROM.
+ * @details Initializes pin modes, serial communication, the background ADC sampler, MIDI, and loads the configuration from EEPROM.
  */
 void setup()
 {
@@ -347,25 +1553,187 @@ void setup()
 
     pinMode(blinker, OUTPUT);
     pinMode(pSUSTAIN, INPUT_PULLUP);
-    POT.setNumReadings(15); // Example: Use 15 readings for averaging
-    POT.setDebounceThreshold(5);
+    attachInterrupt(digitalPinToInterrupt(pSUSTAIN), sustainEdge, CHANGE);
+    ROUTER.setHysteresis(25); // a resting pedal on a step boundary stays quiet
+    BANK.begin(); // sample the pedals in the background, scanning them no longer blocks
     initPedal();
 
+    SCHED.add(handleSustain, 0, sustainBudgetUS, &STATS[statSustain]); // every pass, edges go out at once
+    SCHED.add(scanTask, scanTicks, scanBudgetUS, &STATS[statScan]); // fixed rate
+    SCHED.add(midiTask, 0, midiBudgetUS + 500, &STATS[statMidi]); // the last message may run past midiBudgetUS
+    SCHED.add(benchTask, 0, scanBudgetUS, nullptr); // idle unless `sysexBenchStart` started a run
+    SCHED.add(housekeepingTask, 0, housekeepingBudgetUS, nullptr); // last, after everything time critical
+
     digitalWrite(blinker, LOW);
 
     loadConfig();
-    MIDI.begin(1); // Start MIDI on channel 1
+    if (!STATE.READINGS) {
+        startProfile(false); // a new unit tunes its filter on the first boot, at rest
+    }
+    MIDI.begin(configChannel); // `MIDIIN` reads every channel and filters on configChannel itself
     MIDI.turnThruOff();
+    DIN.begin();
+    SCHED.begin(tickHz);
+}
+
+/**
+ * @brief Scheduler task sampling and dispatching the pedals at the fixed scan rate.
+ *
+ * @details Scans the bank, lets the router compute every destination of the expression pedal from
+ *          its position, then sends the rate limited USB messages that are due and the DIN messages
+ *          the UART has room for. After `idleMS` without movement the pedal goes idle, and while the
+ *          USB host has the bus suspended nothing is scanned or sent at all.
+ *          While idle the scheduler counts `idleScanTicks` ticks per Timer3 interrupt, so this task
+ *          runs once per idle period and samples the pedals with one noise reduction conversion each. A pedal that moved wakes the pedal in the same run: the filters restart
+ *          from that sample, so the first message goes out in this scan, as at full rate.
+ */
+void scanTask()
+{
+    if (USBDevice.isSuspended() != suspended) {
+        suspended = !suspended;
+        if (suspended) {
+            enterIdle();
+        } else {
+            markActive();
+            ROUTER.refresh(); // the host may have missed the last values
+        }
+    }
+    if (suspended) {
+        return;
+    }
+
+    if (idle) {
+        if (!idleScan()) {
+            return;
+        }
+        markActive();
+        for (ATPOT* pot : PEDALS) {
+            pot->restartFilter();
+        }
+    }
+
+    uint16_t position = POT.linearPosition;
+    BANK.scan();
+    ROUTER.update(POT.linearPosition);
+    OUT.update();
+    DIN.update();
+
+    if (POT.linearPosition != position) {
+        activeAt = millis();
+    } else if (idleMS && !benchPattern && !TRACE.isRunning() && (millis() - activeAt) >= idleMS) {
+        enterIdle();
+    }
+}
+
+/**
+ * @brief Notes activity on an input, and leaves the idle state.
+ *
+ * @details Restarts the free-running sampling and the 1 ms scheduler tick, the next scan runs at
+ *          full rate.
+ */
+void markActive()
+{
+    activeAt = millis();
+    if (idle) {
+        idle = false;
+        SCHED.setStride(1);
+        ATADC::resume();
+    }
+}
+
+/**
+ * @brief Enters the idle state.
+ *
+ * @details Pauses the background sampling and keeps the newest reading of every pedal, the
+ *          movement that wakes the pedal is measured from there. Timer3 then only interrupts every
+ *          `idleScanTicks` ticks and `loop()` puts the CPU to sleep after every pass. The Timer3
+ *          interrupt, a sustain edge and USB traffic wake it, and so does the 1 ms Timer0 interrupt
+ *          of `millis()`, which keeps running.
+ */
+void enterIdle()
+{
+    ATADC::pause();
+    for (byte i = 0; i < sizeof(PEDALS) / sizeof(PEDALS[0]); i++) {
+        int8_t slot = ATADC::slot(PEDALS[i]->getPin());
+        idleReadings[i] = slot >= 0 ? ATADC::latest(slot) : 0;
+    }
+    SCHED.setStride(idleScanTicks);
+    idle = true;
+}
+
+/**
+ * @brief Samples every pedal once while idle.
+ *
+ * @return true if a pedal moved by `wakeThreshold` or more since the pedal went idle.
+ *
+ * @details Only the new sample is kept in each buffer, so a pedal that moved is filtered from
+ *          its current position.
+ */
+bool idleScan()
+{
+    ATADC::convert();
+    bool moved = false;
+    for (byte i = 0; i < sizeof(PEDALS) / sizeof(PEDALS[0]); i++) {
+        int8_t slot = ATADC::slot(PEDALS[i]->getPin());
+        if (slot < 0) {
+            continue;
+        }
+        while (ATADC::available(slot) > 1) {
+            ATADC::read(slot);
+        }
+        if (abs(ATADC::latest(slot) - idleReadings[i]) >= wakeThreshold) {
+            moved = true;
+        }
+    }
+    return moved;
+}
+
+/**
+ * @brief Scheduler task handling MIDI input and the USB write, on every pass.
+ *
+ * @details Processes the waiting MIDI messages within `midiBudgetUS`, then writes the buffered
+ *          messages to USB in one transfer once they have been held long enough.
+ */
+void midiTask()
+{
+    handleMidiInput();
+    PACKETS.update();
+}
+
+/**
+ * @brief Scheduler task for the work that has no deadline, on every pass after the other tasks.
+ *
+ * @details Ends a noise profile once `profileMS` are over (tuning it and queueing the save), then
+ *          runs one step of a queued configuration save: returns at once while the EEPROM is still
+ *          writing the last byte, otherwise starts the next byte write (3.3 ms in hardware).
+ */
+void housekeepingTask()
+{
+    if (profiling && !suspended && (millis() - profileStartedAt) >= profileMS) {
+        finishProfile();
+    }
+    STORE.update();
 }
 
 /**
  * @brief Arduino main loop function.
  *
- * @details Continuously scans the expression pedal, handles the sustain pedal, and processes incoming MIDI messages.
+ * @details Runs the scheduler: the sustain pedal and MIDI tasks on every pass, the pedal scan at the
+ *          fixed rate of `tickHz / scanTicks`. Each task and the loop period are timed into `STATS`,
+ *          with the overruns of every task, readable with the `sysexStats` SysEx command.
+ *          While idle the CPU sleeps after every pass.
  */
 void loop()
 {
-    POT.scan();
-    handleSustain();
-    handleMidiInput();
+    static unsigned long lastLoop = micros();
+    unsigned long start = micros();
+    STATS[statLoop].record(start - lastLoop);
+    lastLoop = start;
+
+    SCHED.run();
+
+    if (idle) {
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        sleep_mode(); // until the next Timer3 stride, Timer0 tick, sustain edge or USB interrupt
+    }
 }
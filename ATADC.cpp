@@ -0,0 +1,306 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Amit's interrupt driven ADC sampler (ATmega32u4).
+ *****************************************************************************/
+
+#include "ATADC.h"
+#ifdef __AVR__
+#include <avr/sleep.h>
+#endif
+
+ATQUEUE<int, ATADC_BUFFER_SIZE> ATADC::_queues[ATADC_MAX_CHANNELS];
+byte ATADC::_pins[ATADC_MAX_CHANNELS];
+byte ATADC::_channels[ATADC_MAX_CHANNELS];
+byte ATADC::_slots = 0;
+volatile byte ATADC::_selected = 0;
+volatile byte ATADC::_converting = 0;
+volatile bool ATADC::_settling = false;
+volatile bool ATADC::_paused = false;
+
+/**
+ * @brief Starts free-running conversions on the given analog pin.
+ *
+ * @param pin The analog pin to sample (A0 - A11 or the matching digital pin number).
+ */
+void ATADC::begin(byte pin)
+{
+    begin(&pin, 1);
+}
+
+/**
+ * @brief Starts free-running conversions on several analog pins, sampled in turn.
+ *
+ * @param pins The analog pins to sample.
+ * @param count The number of pins (at most `ATADC_MAX_CHANNELS`).
+ *
+ * @details Selects the channels the same way `analogRead()` does on the Leonardo/Micro,
+ *          uses AVcc as reference, and starts the ADC in free-running mode with the
+ *          conversion complete interrupt enabled, on the first pin.
+ */
+void ATADC::begin(const byte* pins, byte count)
+{
+    noInterrupts();
+    _slots = min(count, ATADC_MAX_CHANNELS);
+    for (byte i = 0; i < _slots; i++) {
+        byte channel = pins[i] >= 18 ? pins[i] - 18 : pins[i];
+        _pins[i] = pins[i];
+        _channels[i] = analogPinToChannel(channel);
+        _queues[i].clear();
+    }
+    start();
+    interrupts();
+}
+
+/**
+ * @brief Stops the free-running conversions and disables the ADC interrupt.
+ *
+ * @details The ADC is left enabled with the default prescaler so `analogRead()` works again.
+ */
+void ATADC::end()
+{
+    noInterrupts();
+#ifdef __AVR__
+    ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+#endif
+    _slots = 0;
+    _paused = false;
+    interrupts();
+}
+
+/**
+ * @brief Stops the free-running conversions but keeps the pins and their buffers.
+ *
+ * @details The ADC stays enabled with its interrupt off, ready for `convert()`.
+ */
+void ATADC::pause()
+{
+    noInterrupts();
+#ifdef __AVR__
+    ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+#endif
+    _paused = true;
+    interrupts();
+}
+
+/**
+ * @brief Restarts the free-running conversions after `pause()`, the buffered samples are kept.
+ */
+void ATADC::resume()
+{
+    noInterrupts();
+    start();
+    interrupts();
+}
+
+/**
+ * @brief Starts the free-running conversions on the first pin, with interrupts off.
+ *
+ * @details Uses AVcc as reference and starts the ADC in free-running mode with the conversion
+ *          complete interrupt enabled.
+ */
+void ATADC::start()
+{
+    _selected = 0;
+    _converting = 0;
+    _settling = _slots > 1;
+    _paused = false;
+#ifdef __AVR__
+    ADCSRA = 0;
+    select(0);
+    ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+#endif
+}
+
+/**
+ * @brief Checks whether the engine is paused.
+ *
+ * @return true between `pause()` and `resume()`.
+ */
+bool ATADC::isPaused()
+{
+    return _paused;
+}
+
+/**
+ * @brief Converts every pin once while paused, with the CPU in ADC noise reduction sleep.
+ *
+ * @details The conversion is started by hand and the CPU put to sleep, the conversion complete
+ *          interrupt wakes it. The I/O clock stops while asleep, so the digital circuits add less
+ *          noise to the reading and `millis()` slips by the conversion time.
+ */
+void ATADC::convert()
+{
+    if (!_paused) {
+        return;
+    }
+    for (byte i = 0; i < _slots; i++) {
+        select(i);
+        for (byte n = _slots > 1 ? 2 : 1; n; n--) {
+#ifdef __AVR__
+            set_sleep_mode(SLEEP_MODE_ADC);
+            noInterrupts();
+            ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+            sleep_enable();
+            interrupts(); // the sleep below still runs before any interrupt
+            sleep_cpu();
+            sleep_disable();
+            while (ADCSRA & (1 << ADSC)) { } // woken early by another interrupt
+#endif
+        }
+#ifdef __AVR__
+        ADCSRA &= ~(1 << ADIE);
+        _queues[i].push(ADC);
+#endif
+    }
+}
+
+/**
+ * @brief Gets the newest sample of a slot without taking it.
+ *
+ * @param slot The slot returned by `slot()`.
+ * @return The newest conversion result (0-1023).
+ */
+int ATADC::latest(byte slot)
+{
+    return _queues[slot].newest();
+}
+
+/**
+ * @brief Gets the time between two samples of the same pin while running.
+ *
+ * @return The sample period in microseconds, one conversion with a single pin, two per pin with
+ *         several (the settling conversion after every switch is thrown away).
+ */
+uint16_t ATADC::period()
+{
+    return _slots > 1 ? 2 * _slots * ATADC_CONVERSION_US : ATADC_CONVERSION_US;
+}
+
+/**
+ * @brief Finds the buffer slot of a pin.
+ *
+ * @param pin The analog pin to look up.
+ * @return The slot sampling this pin, or -1 when the engine is not sampling it.
+ */
+int8_t ATADC::slot(byte pin)
+{
+    for (byte i = 0; i < _slots; i++) {
+        if (_pins[i] == pin) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Checks whether the engine is running on the given pin.
+ *
+ * @param pin The analog pin to check.
+ * @return true if the engine is sampling this pin in the background.
+ */
+bool ATADC::isRunning(byte pin)
+{
+    return slot(pin) >= 0;
+}
+
+/**
+ * @brief Gets the number of samples stored for a slot since they were last read.
+ *
+ * @param slot The slot returned by `slot()`.
+ * @return The number of unread samples (at most `ATADC_BUFFER_SIZE`).
+ */
+byte ATADC::available(byte slot)
+{
+    return _queues[slot].available();
+}
+
+/**
+ * @brief Reads the oldest unread sample of a slot.
+ *
+ * @param slot The slot returned by `slot()`.
+ * @return The oldest unread conversion result (0-1023), or the last one when nothing is unread.
+ *
+ * @details Lock-free: the ISR only moves the write index and never touches a queued sample,
+ *          so reading needs no critical section.
+ */
+int ATADC::read(byte slot)
+{
+    int sample;
+    if (!_queues[slot].pop(sample)) {
+        sample = _queues[slot].newest();
+    }
+    return sample;
+}
+
+/**
+ * @brief Gets the number of samples of a slot dropped because its buffer was full.
+ *
+ * @param slot The slot returned by `slot()`.
+ * @return The number of dropped samples since `begin()`.
+ */
+uint16_t ATADC::dropped(byte slot)
+{
+    return _queues[slot].dropped();
+}
+
+/**
+ * @brief Handles a finished conversion.
+ *
+ * @param sample The conversion result (0-1023).
+ *
+ * @details In free-running mode the next conversion has already started, with the multiplexer
+ *          setting written before it started. A multiplexer change made now only applies to the
+ *          conversion after that one, so the channel of every result is tracked one step behind.
+ *          Once a channel has a kept conversion in progress the multiplexer moves to the next
+ *          channel, and the first conversion on the new channel is discarded.
+ */
+void ATADC::store(int sample)
+{
+    if (_paused) {
+        return; // a conversion of `convert()`, which queues it itself
+    }
+    byte done = _converting;
+    bool discard = _settling;
+    _converting = _selected;
+    _settling = _selected != done;
+
+    if (!discard) {
+        _queues[done].push(sample); // refused and counted when the reader fell behind
+    }
+
+    if (_slots > 1 && !_settling) {
+        // the conversion in progress is a kept one, move on after it
+        byte next = _selected + 1;
+        _selected = next < _slots ? next : 0;
+        select(_selected);
+    }
+}
+
+/**
+ * @brief Programs the multiplexer for a slot's channel.
+ */
+void ATADC::select(byte slot)
+{
+#ifdef __AVR__
+    byte channel = _channels[slot];
+    ADCSRB = (((channel >> 3) & 0x01) << MUX5); // ADTS = 000, free running
+    ADMUX = (1 << REFS0) | (channel & 0x07);
+#else
+    (void)slot; // host builds have no multiplexer
+#endif
+}
+
+#ifdef __AVR__
+/**
+ * @brief ADC conversion complete interrupt, hands the result to the sampler.
+ */
+ISR(ADC_vect)
+{
+    ATADC::store(ADC);
+}
+#endif
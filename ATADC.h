@@ -0,0 +1,218 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's interrupt driven ADC sampler (ATmega32u4).
+ *****************************************************************************/
+
+#ifndef ATADC_H
+#define ATADC_H
+#include "ATQUEUE.h"
+#include <Arduino.h>
+
+/**
+ * @brief Number of samples kept per channel in the background sample buffer (a power of two, at most 128).
+ *
+ * @details One pot gets a conversion every 104 us, 16 samples cover a 1 ms scan period.
+ */
+#define ATADC_BUFFER_SIZE 16
+
+#ifndef ATADC_MAX_CHANNELS
+/**
+ * @brief Maximum number of analog pins the engine can sample in turn (1-12, build with -D to change).
+ *
+ * @details Every channel takes 38 bytes of RAM (its sample buffer, pin and multiplexer setting),
+ *          whether it is used or not. With N pins each pin gets one sample every 2 x N x 104 us, so
+ *          at the 12 analog inputs of the 32u4 a pin is sampled about every 2.5 ms, slower than the
+ *          1 ms scan period. A bank of more pots does not build (`ATPOTBANK`).
+ */
+#define ATADC_MAX_CHANNELS 4
+#endif
+static_assert(ATADC_MAX_CHANNELS >= 1 && ATADC_MAX_CHANNELS <= 12, "the 32u4 has 12 analog inputs, ATADC_MAX_CHANNELS is 1-12");
+
+/**
+ * @brief Time one free-running conversion takes, 13 ADC clocks at prescaler 128 and 16 MHz (us).
+ */
+#define ATADC_CONVERSION_US 104
+
+/**
+ * @brief Free-running ADC engine that samples one or more analog pins in the background.
+ *
+ * @details The ADC is put in auto-trigger (free-running) mode with its conversion complete
+ *          interrupt enabled. Every finished conversion is stored in the ring buffer of its
+ *          channel from the ISR, so readers never wait on a conversion. The buffers are lock-free
+ *          single producer, single consumer queues (`ATQUEUE`), reading a sample never turns
+ *          interrupts off. At the default
+ *          prescaler (128) a conversion completes roughly every 104 us.
+ *          With more than one pin the ISR round-robins the multiplexer: the next conversion is
+ *          already running in hardware while the main loop filters and dispatches the previous
+ *          result, and the first conversion after every multiplexer switch is thrown away so the
+ *          sample and hold capacitor can settle. Each pin then gets one sample every 2 conversions
+ *          times the number of pins.
+ *          While the engine is running `analogRead()` must not be used, as it would reprogram the
+ *          ADC multiplexer and stop the free-running mode.
+ *          For a low power idle state the engine can be paused: the pins keep their buffers, and
+ *          `convert()` fills them one conversion at a time with the CPU asleep.
+ */
+class ATADC {
+
+public:
+    /**
+     * @brief Starts free-running conversions on the given analog pin.
+     *
+     * @param pin The analog pin to sample (A0 - A11 or the matching digital pin number).
+     */
+    static void begin(byte pin);
+
+    /**
+     * @brief Starts free-running conversions on several analog pins, sampled in turn.
+     *
+     * @param pins The analog pins to sample.
+     * @param count The number of pins (at most `ATADC_MAX_CHANNELS`).
+     */
+    static void begin(const byte* pins, byte count);
+
+    /**
+     * @brief Stops the free-running conversions and disables the ADC interrupt.
+     */
+    static void end();
+
+    /**
+     * @brief Stops the free-running conversions but keeps the pins and their buffers.
+     *
+     * @details Readers keep working, they only get what `convert()` adds.
+     */
+    static void pause();
+
+    /**
+     * @brief Restarts the free-running conversions after `pause()`, the buffered samples are kept.
+     */
+    static void resume();
+
+    /**
+     * @brief Checks whether the engine is paused.
+     *
+     * @return true between `pause()` and `resume()`.
+     */
+    static bool isPaused();
+
+    /**
+     * @brief Converts every pin once while paused, with the CPU in ADC noise reduction sleep.
+     *
+     * @details Blocks for one conversion per pin (two with several pins, the first after a
+     *          multiplexer switch is thrown away), about 104 us each. Other interrupts wake the
+     *          CPU early and are served, the conversion carries on. Does nothing while running.
+     */
+    static void convert();
+
+    /**
+     * @brief Gets the newest sample of a slot without taking it.
+     *
+     * @param slot The slot returned by `slot()`.
+     * @return The newest conversion result (0-1023).
+     */
+    static int latest(byte slot);
+
+    /**
+     * @brief Gets the time between two samples of the same pin while running.
+     *
+     * @return The sample period in microseconds.
+     */
+    static uint16_t period();
+
+    /**
+     * @brief Finds the buffer slot of a pin.
+     *
+     * @param pin The analog pin to look up.
+     * @return The slot sampling this pin, or -1 when the engine is not sampling it.
+     */
+    static int8_t slot(byte pin);
+
+    /**
+     * @brief Checks whether the engine is running on the given pin.
+     *
+     * @param pin The analog pin to check.
+     * @return true if the engine is sampling this pin in the background.
+     */
+    static bool isRunning(byte pin);
+
+    /**
+     * @brief Gets the number of samples stored for a slot since they were last read.
+     *
+     * @param slot The slot returned by `slot()`.
+     * @return The number of unread samples (at most `ATADC_BUFFER_SIZE`).
+     */
+    static byte available(byte slot);
+
+    /**
+     * @brief Reads the oldest unread sample of a slot.
+     *
+     * @param slot The slot returned by `slot()`.
+     * @return The oldest unread conversion result (0-1023), or the last one when nothing is unread.
+     *
+     * @details If the reader falls more than `ATADC_BUFFER_SIZE` samples behind, the newer
+     *          samples are dropped (see `dropped()`) until it catches up, the queued ones are never
+     *          overwritten under the reader.
+     */
+    static int read(byte slot);
+
+    /**
+     * @brief Gets the number of samples of a slot dropped because its buffer was full.
+     *
+     * @param slot The slot returned by `slot()`.
+     * @return The number of dropped samples since `begin()`.
+     */
+    static uint16_t dropped(byte slot);
+
+    /**
+     * @brief Handles a finished conversion.
+     *
+     * @param sample The conversion result (0-1023).
+     *
+     * @details Called from the ADC interrupt. Stores the result in the buffer of the channel it
+     *          was converted from (unless it is the settling conversion after a switch) and moves
+     *          the multiplexer on. Not meant to be called from sketch code, host builds
+     *          (see `extras/hostsim`) call it to feed simulated conversions.
+     */
+    static void store(int sample);
+
+private:
+    /**
+     * @brief Programs the multiplexer for a slot's channel.
+     */
+    static void select(byte slot);
+
+    /**
+     * @brief Starts the free-running conversions on the first pin, with interrupts off.
+     */
+    static void start();
+
+    static ATQUEUE<int, ATADC_BUFFER_SIZE> _queues[ATADC_MAX_CHANNELS];
+    static byte _pins[ATADC_MAX_CHANNELS];
+    static byte _channels[ATADC_MAX_CHANNELS];
+    static byte _slots;
+
+    /**
+     * @brief Slot the multiplexer is set to, used by the conversion after the one in progress.
+     */
+    static volatile byte _selected;
+
+    /**
+     * @brief Slot of the conversion in progress.
+     */
+    static volatile byte _converting;
+
+    /**
+     * @brief Whether the conversion in progress is the first one after a multiplexer switch.
+     */
+    static volatile bool _settling;
+
+    /**
+     * @brief Whether the engine is paused, the interrupt then leaves the buffers to `convert()`.
+     */
+    static volatile bool _paused;
+};
+#endif
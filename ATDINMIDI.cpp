@@ -0,0 +1,186 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Amit's non blocking DIN MIDI (serial) CC writer.
+ *****************************************************************************/
+
+#include "ATDINMIDI.h"
+
+/**
+ * @brief Constructor for the ATDINMIDI class.
+ *
+ * @param port The hardware serial port wired to the DIN socket.
+ */
+ATDINMIDI::ATDINMIDI(HardwareSerial& port)
+    : _port(port)
+{
+    for (byte i = 0; i < ATDINMIDI_SLOTS; i++) {
+        _slots[i].ch = 0;
+        _slots[i].pending = false;
+    }
+}
+
+/**
+ * @brief Opens the serial port at the MIDI baud rate.
+ */
+void ATDINMIDI::begin()
+{
+    _port.begin(ATDINMIDI_BAUD);
+    resetRunningStatus();
+}
+
+/**
+ * @brief Queues a 7 bit Control Change message and writes what fits.
+ *
+ * @param cc The MIDI CC number.
+ * @param value The CC value (0-127).
+ * @param ch The MIDI channel (1-16).
+ */
+void ATDINMIDI::controlChange(byte cc, byte value, byte ch)
+{
+    queue(cc, value, ch, false);
+}
+
+/**
+ * @brief Queues a 14 bit CC value, sent as an MSB/LSB pair on CC n and n + 32, and writes what fits.
+ *
+ * @param cc The MSB CC number (0-31).
+ * @param value The 14 bit value (0-16383).
+ * @param ch The MIDI channel (1-16).
+ */
+void ATDINMIDI::controlChange14(byte cc, uint16_t value, byte ch)
+{
+    queue(cc, value, ch, true);
+}
+
+/**
+ * @brief Queues the Control Change of a switch (sustain) and writes what fits.
+ *
+ * @param cc The MIDI CC number.
+ * @param value The CC value (0-127).
+ * @param ch The MIDI channel (1-16).
+ */
+void ATDINMIDI::switchChange(byte cc, byte value, byte ch)
+{
+    if (!_events.push({ ch, cc, false, true, value })) {
+        droppedCount++;
+    }
+    update();
+}
+
+/**
+ * @brief Puts a value in its destination's slot, then writes what fits.
+ *
+ * @details Finds the destination's slot, or takes one with nothing waiting. When every slot holds a
+ *          waiting value for another destination the value is dropped and counted in `droppedCount`,
+ *          the caller never waits for the UART.
+ */
+void ATDINMIDI::queue(byte cc, uint16_t value, byte ch, bool hires)
+{
+    Slot* slot = nullptr;
+    Slot* free = nullptr;
+    for (byte i = 0; i < ATDINMIDI_SLOTS; i++) {
+        if (_slots[i].pending && _slots[i].ch == ch && _slots[i].cc == cc && _slots[i].hires == hires) {
+            slot = &_slots[i];
+            break;
+        }
+        if (free == nullptr && !_slots[i].pending) {
+            free = &_slots[i];
+        }
+    }
+
+    if (slot != nullptr) {
+        coalescedCount++; // the waiting value is replaced by this one
+    } else if (free != nullptr) {
+        slot = free;
+        slot->ch = ch;
+        slot->cc = cc;
+        slot->hires = hires;
+    } else {
+        droppedCount++;
+        update();
+        return;
+    }
+    slot->value = value;
+    slot->pending = true;
+    update();
+}
+
+/**
+ * @brief Writes the waiting messages that fit into the transmit buffer.
+ *
+ * @details Writes the waiting switch messages in order first. Then walks the slots round-robin
+ *          from where the last pass stopped and stops at the first message that does not fit, so
+ *          the destinations take turns while the port is busy.
+ */
+void ATDINMIDI::update()
+{
+    Slot event;
+    while (_events.peek(event)) {
+        if (!transmit(event)) {
+            return;
+        }
+        _events.pop(event);
+    }
+
+    for (byte n = 0; n < ATDINMIDI_SLOTS; n++) {
+        Slot& slot = _slots[_next];
+        if (slot.pending && !transmit(slot)) {
+            return;
+        }
+        _next = _next + 1 < ATDINMIDI_SLOTS ? _next + 1 : 0;
+    }
+}
+
+/**
+ * @brief Forgets the running status, the next message starts with its status byte.
+ */
+void ATDINMIDI::resetRunningStatus()
+{
+    _runningStatus = 0;
+}
+
+/**
+ * @brief Writes one slot's message if the transmit buffer has room for all of it.
+ *
+ * @return true if the message was written.
+ *
+ * @details The message is written whole or not at all, so a running status stream is never
+ *          left with half a message while the value waits.
+ */
+bool ATDINMIDI::transmit(Slot& slot)
+{
+    byte status = 0xB0 | ((slot.ch - 1) & 0x0F);
+    unsigned long now = millis();
+    bool withStatus = status != _runningStatus || (now - _statusAt) >= ATDINMIDI_STATUS_HOLD_MS;
+    int length = (withStatus ? 1 : 0) + (slot.hires ? 4 : 2);
+    if (_port.availableForWrite() < length) {
+        return false;
+    }
+
+    if (withStatus) {
+        _port.write(status);
+        _runningStatus = status;
+        _statusAt = now;
+    } else {
+        runningCount++;
+    }
+    if (slot.hires) {
+        _port.write(slot.cc & 0x7F);
+        _port.write((slot.value >> 7) & 0x7F);
+        _port.write((slot.cc + 32) & 0x7F);
+        _port.write(slot.value & 0x7F);
+        sentCount += 2;
+        runningCount++; // the LSB always runs on the MSB's status
+    } else {
+        _port.write(slot.cc & 0x7F);
+        _port.write(slot.value & 0x7F);
+        sentCount++;
+    }
+    slot.pending = false;
+    return true;
+}
@@ -0,0 +1,186 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's non blocking DIN MIDI (serial) CC writer.
+ *****************************************************************************/
+
+#ifndef ATDINMIDI_H
+#define ATDINMIDI_H
+#include "ATQUEUE.h"
+#include <Arduino.h>
+
+/**
+ * @brief Number of CC destinations (channel + CC pairs) that can wait for room at the same time.
+ */
+#define ATDINMIDI_SLOTS 8
+
+/**
+ * @brief Number of switch messages (`switchChange()`) that can wait for room, a power of two.
+ */
+#define ATDINMIDI_EVENTS 4
+
+/**
+ * @brief MIDI baud rate.
+ */
+#define ATDINMIDI_BAUD 31250
+
+/**
+ * @brief Time after which the status byte is sent again even when running status would allow
+ *        leaving it out, so a receiver plugged in mid-stream picks the stream up (ms).
+ */
+#define ATDINMIDI_STATUS_HOLD_MS 1000
+
+/**
+ * @brief Non-blocking Control Change writer for a 5-pin DIN MIDI port.
+ *
+ * @details Writes to a hardware serial port (`Serial1` on the Leonardo/Micro), whose interrupt driven
+ *          transmit ring buffer shifts the bytes out at 31250 baud. A message is only written when the
+ *          ring buffer has room for all of it (`availableForWrite()`), so the caller never waits on the
+ *          UART. Until then the value waits in its destination's slot, and a newer value for the same
+ *          destination replaces it, so a backed up port sends fewer, current values instead of an
+ *          ever growing backlog. There is one slot per destination, up to `ATDINMIDI_SLOTS`. Consecutive messages with the same status byte use MIDI running
+ *          status: a CC takes 2 bytes instead of 3, and a 14 bit pair 5 bytes instead of 6.
+ */
+class ATDINMIDI {
+
+public:
+    /**
+     * @brief Constructor for the ATDINMIDI class.
+     *
+     * @param port The hardware serial port wired to the DIN socket.
+     */
+    ATDINMIDI(HardwareSerial& port);
+
+    /**
+     * @brief Opens the serial port at the MIDI baud rate.
+     */
+    void begin();
+
+    /**
+     * @brief Queues a 7 bit Control Change message and writes what fits.
+     *
+     * @param cc The MIDI CC number.
+     * @param value The CC value (0-127).
+     * @param ch The MIDI channel (1-16).
+     */
+    void controlChange(byte cc, byte value, byte ch);
+
+    /**
+     * @brief Queues a 14 bit CC value, sent as an MSB/LSB pair on CC n and n + 32, and writes what fits.
+     *
+     * @param cc The MSB CC number (0-31).
+     * @param value The 14 bit value (0-16383).
+     * @param ch The MIDI channel (1-16).
+     *
+     * @details Both halves of the pair wait and go out together.
+     */
+    void controlChange14(byte cc, uint16_t value, byte ch);
+
+    /**
+     * @brief Queues the Control Change of a switch (sustain) and writes what fits.
+     *
+     * @param cc The MIDI CC number.
+     * @param value The CC value (0-127).
+     * @param ch The MIDI channel (1-16).
+     *
+     * @details A switch is an event, not a level: every change waits in order and none is
+     *          coalesced, so a short press and release while the port is busy still sends both.
+     *          Waiting switch messages go out ahead of the waiting CC values.
+     */
+    void switchChange(byte cc, byte value, byte ch);
+
+    /**
+     * @brief Writes the waiting messages that fit into the transmit buffer.
+     *
+     * @details Call this on every pass of the main loop, so waiting values go out as the UART drains.
+     */
+    void update();
+
+    /**
+     * @brief Forgets the running status, the next message starts with its status byte.
+     *
+     * @details Call this when something else wrote to the port.
+     */
+    void resetRunningStatus();
+
+    /**
+     * @brief Number of CC messages written (a 14 bit pair counts as two).
+     */
+    unsigned long sentCount = 0;
+
+    /**
+     * @brief Number of waiting values that were replaced by a newer one before they were written.
+     */
+    unsigned long coalescedCount = 0;
+
+    /**
+     * @brief Number of status bytes left out thanks to running status.
+     */
+    unsigned long runningCount = 0;
+
+    /**
+     * @brief Number of values dropped because every slot was waiting for another destination, or
+     *        switch messages because `ATDINMIDI_EVENTS` were already waiting.
+     *
+     * @details Stays 0 as long as no more than `ATDINMIDI_SLOTS` destinations are in use.
+     */
+    unsigned long droppedCount = 0;
+
+private:
+    /**
+     * @brief State of one CC destination.
+     */
+    struct Slot {
+        /** @brief MIDI channel, 0 when the slot is unused. */
+        byte ch;
+        /** @brief MIDI CC number. */
+        byte cc;
+        /** @brief Whether the value is sent as a 14 bit pair. */
+        bool hires;
+        /** @brief Whether `value` is still waiting. */
+        bool pending;
+        /** @brief The waiting value. */
+        uint16_t value;
+    };
+
+    /**
+     * @brief Puts a value in its destination's slot, then writes what fits.
+     */
+    void queue(byte cc, uint16_t value, byte ch, bool hires);
+
+    /**
+     * @brief Writes one slot's message if the transmit buffer has room for all of it.
+     *
+     * @return true if the message was written.
+     */
+    bool transmit(Slot& slot);
+
+    HardwareSerial& _port;
+
+    Slot _slots[ATDINMIDI_SLOTS];
+
+    /**
+     * @brief Switch messages waiting for room, oldest first.
+     */
+    ATQUEUE<Slot, ATDINMIDI_EVENTS> _events;
+
+    /**
+     * @brief Slot `update()` starts with, so every destination gets its turn on a busy port.
+     */
+    byte _next = 0;
+
+    /**
+     * @brief Status byte of the last message written, 0 when a receiver can not rely on it.
+     */
+    byte _runningStatus = 0;
+
+    /**
+     * @brief Time the last status byte was written (millis).
+     */
+    unsigned long _statusAt = 0;
+};
+#endif
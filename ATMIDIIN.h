@@ -0,0 +1,73 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's MIDI input channel filter.
+ *****************************************************************************/
+
+#ifndef ATMIDIIN_H
+#define ATMIDIIN_H
+#include <Arduino.h>
+
+#ifndef MIDI_CHANNEL_OMNI
+/** @brief Channel argument of `MidiInterface::read()` that accepts every channel (as the MIDI library). */
+#define MIDI_CHANNEL_OMNI 0
+#endif
+
+/**
+ * @brief Reads the MIDI input of the pedal, skipping channel messages for other channels.
+ *
+ * @tparam Midi The MIDI library interface (`MIDI` of the sketch, a mock on the host).
+ *
+ * @details The MIDI library's `read()` parses a channel message for another channel than the one
+ *          given to `begin()` and then returns false, as if nothing was waiting, so a loop on it stops
+ *          at the first such message. `read()` here always parses on every channel and skips the
+ *          channel messages for other channels itself, so it only returns false once the input is
+ *          empty. System messages (SysEx, clock ...) have no channel and are always returned.
+ */
+template <typename Midi>
+class ATMIDIIN {
+
+public:
+    /**
+     * @brief Constructor for the ATMIDIIN class.
+     *
+     * @param midi The MIDI interface to read from.
+     * @param channel The channel the pedal listens on (1-16).
+     */
+    ATMIDIIN(Midi& midi, byte channel)
+        : _midi(midi)
+        , _channel(channel)
+    {
+    }
+
+    /**
+     * @brief Reads the next message for the pedal.
+     *
+     * @return true with a message in the interface (`getType()`, `getData1()` ...), false once
+     *         nothing is left.
+     */
+    bool read()
+    {
+        while (_midi.read(MIDI_CHANNEL_OMNI)) {
+            if ((byte)_midi.getType() >= 0xF0 || _midi.getChannel() == _channel) {
+                return true;
+            }
+            skipped++; // a channel message for another device
+        }
+        return false;
+    }
+
+    /**
+     * @brief Number of channel messages skipped because they were for another channel.
+     */
+    unsigned long skipped = 0;
+
+private:
+    Midi& _midi;
+    byte _channel;
+};
+#endif
@@ -0,0 +1,147 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Amit's rate limited MIDI CC output scheduler.
+ *****************************************************************************/
+
+#include "ATMIDIOUT.h"
+
+/**
+ * @brief Constructor for the ATMIDIOUT class.
+ *
+ * @param sender function that puts one CC message on the transport (cc, value, channel).
+ */
+ATMIDIOUT::ATMIDIOUT(void (*sender)(byte, byte, byte))
+{
+    _sender = sender;
+    for (byte i = 0; i < ATMIDIOUT_SLOTS; i++) {
+        _slots[i].ch = 0;
+        _slots[i].pending = false;
+    }
+}
+
+/**
+ * @brief Sets the maximum message rate per destination.
+ *
+ * @param perSecond Messages per second per destination, 0 disables rate limiting.
+ */
+void ATMIDIOUT::setRate(unsigned int perSecond)
+{
+    _interval = perSecond ? 1000000UL / perSecond : 0;
+}
+
+/**
+ * @brief Gets the maximum message rate per destination.
+ *
+ * @return Messages per second per destination, 0 when rate limiting is disabled.
+ */
+unsigned int ATMIDIOUT::getRate() const
+{
+    return _interval ? 1000000UL / _interval : 0;
+}
+
+/**
+ * @brief Queues a 7 bit CC value.
+ *
+ * @param cc The MIDI CC number.
+ * @param value The CC value (0-127).
+ * @param ch The MIDI channel (1-16).
+ */
+void ATMIDIOUT::send(byte cc, byte value, byte ch)
+{
+    queue(cc, value, ch, false);
+}
+
+/**
+ * @brief Queues a 14 bit CC value, sent as an MSB/LSB pair on CC n and n + 32.
+ *
+ * @param cc The MSB CC number (0-31).
+ * @param value The 14 bit value (0-16383).
+ * @param ch The MIDI channel (1-16).
+ */
+void ATMIDIOUT::send14(byte cc, uint16_t value, byte ch)
+{
+    queue(cc, value, ch, true);
+}
+
+/**
+ * @brief Queues a value for a destination, sending it right away when its interval has elapsed.
+ *
+ * @details Finds the destination's slot, or takes a free one. A slot is free when it was never
+ *          used, or when nothing is pending on it and its interval has elapsed. When all slots are
+ *          busy with other destinations the value bypasses the scheduler and is sent directly.
+ */
+void ATMIDIOUT::queue(byte cc, uint16_t value, byte ch, bool hires)
+{
+    unsigned long now = micros();
+    Slot* slot = nullptr;
+    Slot* free = nullptr;
+    for (byte i = 0; i < ATMIDIOUT_SLOTS; i++) {
+        if (_slots[i].ch == ch && _slots[i].cc == cc && _slots[i].hires == hires) {
+            slot = &_slots[i];
+            break;
+        }
+        if (free == nullptr && (_slots[i].ch == 0 || (!_slots[i].pending && (now - _slots[i].sentAt) >= _interval))) {
+            free = &_slots[i];
+        }
+    }
+
+    if (slot == nullptr) {
+        if (free == nullptr) {
+            Slot direct = { ch, cc, hires, true, value, value, now };
+            transmit(direct, now);
+            return;
+        }
+        slot = free; // new destination
+        slot->ch = ch;
+        slot->cc = cc;
+        slot->hires = hires;
+        slot->pending = false;
+        slot->sentValue = ~value;
+        slot->sentAt = now - _interval;
+    }
+
+    if (slot->pending) {
+        suppressedCount++; // the waiting value is superseded by this one
+    }
+    slot->value = value;
+    slot->pending = value != slot->sentValue; // back at the last sent value, nothing to say
+    if (slot->pending && (now - slot->sentAt) >= _interval) {
+        transmit(*slot, now);
+    }
+}
+
+/**
+ * @brief Sends the pending values whose destination interval has elapsed.
+ */
+void ATMIDIOUT::update()
+{
+    unsigned long now = micros();
+    for (byte i = 0; i < ATMIDIOUT_SLOTS; i++) {
+        if (_slots[i].pending && (now - _slots[i].sentAt) >= _interval) {
+            transmit(_slots[i], now);
+        }
+    }
+}
+
+/**
+ * @brief Puts a slot's value on the transport.
+ */
+void ATMIDIOUT::transmit(Slot& slot, unsigned long now)
+{
+    if (slot.hires) {
+        _sender(slot.cc, slot.value >> 7, slot.ch);
+        _sender(slot.cc + 32, slot.value & 0x7F, slot.ch);
+        sentCount += 2;
+    } else {
+        _sender(slot.cc, slot.value, slot.ch);
+        sentCount++;
+    }
+    slot.sentValue = slot.value;
+    slot.sentAt = now;
+    slot.pending = false;
+}
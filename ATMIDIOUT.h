@@ -0,0 +1,133 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's rate limited MIDI CC output scheduler.
+ *****************************************************************************/
+
+#ifndef ATMIDIOUT_H
+#define ATMIDIOUT_H
+#include <Arduino.h>
+
+/**
+ * @brief Number of CC destinations (channel + CC pairs) the scheduler can track.
+ */
+#define ATMIDIOUT_SLOTS 4
+
+/**
+ * @brief Rate limited, coalescing output stage for MIDI Control Change messages.
+ *
+ * @details Sits between the pot change handlers and the MIDI transport. Each destination
+ *          (channel and CC number) is sent at most `rate` times per second. A value that arrives
+ *          while its destination is still waiting replaces the pending one, so superseded values
+ *          are dropped, and the last (resting) value is always delivered by `update()` once the
+ *          destination's interval has elapsed. The first change after a quiet period goes out immediately.
+ */
+class ATMIDIOUT {
+
+public:
+    /**
+     * @brief Constructor for the ATMIDIOUT class.
+     *
+     * @param sender function that puts one CC message on the transport (cc, value, channel).
+     */
+    ATMIDIOUT(void (*sender)(byte, byte, byte));
+
+    /**
+     * @brief Sets the maximum message rate per destination.
+     *
+     * @param perSecond Messages per second per destination, 0 disables rate limiting.
+     */
+    void setRate(unsigned int perSecond);
+
+    /**
+     * @brief Gets the maximum message rate per destination.
+     *
+     * @return Messages per second per destination, 0 when rate limiting is disabled.
+     */
+    unsigned int getRate() const;
+
+    /**
+     * @brief Queues a 7 bit CC value.
+     *
+     * @param cc The MIDI CC number.
+     * @param value The CC value (0-127).
+     * @param ch The MIDI channel (1-16).
+     */
+    void send(byte cc, byte value, byte ch);
+
+    /**
+     * @brief Queues a 14 bit CC value, sent as an MSB/LSB pair on CC n and n + 32.
+     *
+     * @param cc The MSB CC number (0-31).
+     * @param value The 14 bit value (0-16383).
+     * @param ch The MIDI channel (1-16).
+     *
+     * @details Both halves of the pair are always sent together and count as one message.
+     */
+    void send14(byte cc, uint16_t value, byte ch);
+
+    /**
+     * @brief Sends the pending values whose destination interval has elapsed.
+     *
+     * @details Call this on every pass of the main loop.
+     */
+    void update();
+
+    /**
+     * @brief Number of CC messages put on the transport (a 14 bit pair counts as two).
+     */
+    unsigned long sentCount = 0;
+
+    /**
+     * @brief Number of values that were superseded or cancelled before they were sent.
+     */
+    unsigned long suppressedCount = 0;
+
+private:
+    /**
+     * @brief State of one CC destination.
+     */
+    struct Slot {
+        /** @brief MIDI channel, 0 when the slot is unused. */
+        byte ch;
+        /** @brief MIDI CC number. */
+        byte cc;
+        /** @brief Whether the value is sent as a 14 bit pair. */
+        bool hires;
+        /** @brief Whether `value` still has to be sent. */
+        bool pending;
+        /** @brief The pending value, or the last sent value when nothing is pending. */
+        uint16_t value;
+        /** @brief The last value put on the transport. */
+        uint16_t sentValue;
+        /** @brief Time of the last send in microseconds. */
+        unsigned long sentAt;
+    };
+
+    /**
+     * @brief Queues a value for a destination, sending it right away when its interval has elapsed.
+     */
+    void queue(byte cc, uint16_t value, byte ch, bool hires);
+
+    /**
+     * @brief Puts a slot's value on the transport.
+     */
+    void transmit(Slot& slot, unsigned long now);
+
+    Slot _slots[ATMIDIOUT_SLOTS];
+
+    /**
+     * @brief Minimum time between two messages to one destination in microseconds.
+     */
+    unsigned long _interval = 0;
+
+    /**
+     * @brief Pointer to the function that puts a CC message on the transport.
+     */
+    void (*_sender)(byte, byte, byte) = nullptr;
+};
+#endif
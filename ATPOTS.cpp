@@ -9,79 +9,111 @@
  *****************************************************************************/
 
 #include "ATPOTS.h"
+#include "ATADC.h"
+#include "ATDINMIDI.h"
+#include "ATTRACE.h"
+
+#define ATPOT_STRING(x) #x
+#define ATPOT_VALUE(x) ATPOT_STRING(x)
+#pragma message("ATPOT " ATPOT_VALUE(ATPOT_BYTES) " bytes of RAM per pot, ATMIDICCPOT " ATPOT_VALUE( \
+    ATMIDICCPOT_EXTRA_BYTES) " more (ATPOT_MAX_READINGS " ATPOT_VALUE(ATPOT_MAX_READINGS) ")")
+#ifdef __AVR_ATmega32U4__
+static_assert(sizeof(ATPOT) == ATPOT_BYTES, "ATPOT_BYTES no longer matches the members of ATPOT");
+static_assert(sizeof(ATMIDICCPOT) == ATPOT_BYTES + ATMIDICCPOT_EXTRA_BYTES,
+    "ATMIDICCPOT_EXTRA_BYTES no longer matches the members of ATMIDICCPOT");
+#endif
+
+/**
+ * @brief Cube of an integer, usable in constant expressions.
+ */
+static constexpr long cube(long x)
+{
+    return x * x * x;
+}
 
 /**
- * @brief Constructor for the ATPOT class.
+ * @brief Computes one knot of a built-in response curve at compile time.
  *
- * @param pin The analog pin connected to the potentiometer.
- * @param minVal The minimum output value of the potentiometer.
- * @param maxVal The maximum output value of the potentiometer.
- * @param deadZonePercent The dead zone percentage to compensate for low-precision potentiometers.
+ * @param curve The curve (`ATPOT_CURVE_LINEAR` ... `ATPOT_CURVE_REVERSE`).
+ * @param i The knot (0 - `ATPOT_LUT_SEGMENTS`).
+ * @return The position at that knot (0-16383).
  *
- * @details Initializes the potentiometer with custom minimum and maximum values, and a dead zone.
- *          The dead zone is calculated as a percentage of the total range (0-1023).
+ * @details With x = i / `ATPOT_LUT_SEGMENTS`: log is 1 - (1 - x)^3, exp is x^3,
+ *          the S-curve is 3x^2 - 2x^3 and reverse is 1 - x.
  */
-ATPOT::ATPOT(byte pin, int minVal, int maxVal, float deadZonePercent)
+static constexpr uint16_t curveKnot(byte curve, long i)
 {
-    _minVal = minVal;
-    _maxVal = maxVal;
-    _deadZonePercent = deadZonePercent;
-    _pin = pin;
-    _deadZoneFactor = MAX_ANALOG_POT_READING * _deadZonePercent / 100;
+    return curve == ATPOT_CURVE_LOG ? MAX_HIRES_POT_VALUE - cube(ATPOT_LUT_SEGMENTS - i) * MAX_HIRES_POT_VALUE / cube(ATPOT_LUT_SEGMENTS)
+        : curve == ATPOT_CURVE_EXP ? cube(i) * MAX_HIRES_POT_VALUE / cube(ATPOT_LUT_SEGMENTS)
+        : curve == ATPOT_CURVE_SCURVE ? (3 * i * i * ATPOT_LUT_SEGMENTS - 2 * cube(i)) * MAX_HIRES_POT_VALUE / cube(ATPOT_LUT_SEGMENTS)
+        : curve == ATPOT_CURVE_REVERSE ? (ATPOT_LUT_SEGMENTS - i) * MAX_HIRES_POT_VALUE / ATPOT_LUT_SEGMENTS
+                                      : i * MAX_HIRES_POT_VALUE / ATPOT_LUT_SEGMENTS;
 }
 
+#define CURVE_KNOTS(c)                                                                                     \
+    {                                                                                                      \
+        curveKnot(c, 0), curveKnot(c, 1), curveKnot(c, 2), curveKnot(c, 3), curveKnot(c, 4),               \
+            curveKnot(c, 5), curveKnot(c, 6), curveKnot(c, 7), curveKnot(c, 8), curveKnot(c, 9),           \
+            curveKnot(c, 10), curveKnot(c, 11), curveKnot(c, 12), curveKnot(c, 13), curveKnot(c, 14),      \
+            curveKnot(c, 15), curveKnot(c, 16), curveKnot(c, 17), curveKnot(c, 18), curveKnot(c, 19),      \
+            curveKnot(c, 20), curveKnot(c, 21), curveKnot(c, 22), curveKnot(c, 23), curveKnot(c, 24),      \
+            curveKnot(c, 25), curveKnot(c, 26), curveKnot(c, 27), curveKnot(c, 28), curveKnot(c, 29),      \
+            curveKnot(c, 30), curveKnot(c, 31), curveKnot(c, 32)                                           \
+    }
+
+static_assert(ATPOT_LUT_SEGMENTS == 32, "CURVE_KNOTS lists one knot per curve segment end");
+
+/**
+ * @brief The built-in response curves, generated at compile time and kept in flash.
+ */
+static const uint16_t CURVES[ATPOT_CURVE_COUNT][ATPOT_LUT_SEGMENTS + 1] PROGMEM = {
+    CURVE_KNOTS(ATPOT_CURVE_LINEAR),
+    CURVE_KNOTS(ATPOT_CURVE_LOG),
+    CURVE_KNOTS(ATPOT_CURVE_EXP),
+    CURVE_KNOTS(ATPOT_CURVE_SCURVE),
+    CURVE_KNOTS(ATPOT_CURVE_REVERSE),
+};
+
 /**
- * @brief Constructor for the ATPOT class.
+ * @brief Constructor for the ATPOT class with custom minimum and maximum values and no dead zone.
  *
  * @param pin The analog pin connected to the potentiometer.
  * @param minVal The minimum output value of the potentiometer.
  * @param maxVal The maximum output value of the potentiometer.
- * @param deadZonePercent The dead zone percentage to compensate for low-precision potentiometers.
- *
- * @details Initializes the potentiometer with custom minimum and maximum values, and a dead zone.
- *          The dead zone is calculated as a percentage of the total range (0-1023).
  */
-ATPOT::ATPOT(byte pin, int minVal, int maxVal, float deadZonePercent, void (*handler)(byte, byte))
+ATPOT::ATPOT(byte pin, int minVal, int maxVal)
 {
-    _minVal = minVal;
-    _maxVal = maxVal;
-    _deadZonePercent = deadZonePercent;
-    _pin = pin;
-    _deadZoneFactor = MAX_ANALOG_POT_READING * _deadZonePercent / 100;
-    setChangeHandler(handler);
+    init(pin, minVal, maxVal, 0);
 }
 
 /**
- * @brief Constructor for the ATPOT class with a dead zone.
+ * @brief Basic constructor for the ATPOT class.
  *
  * @param pin The analog pin connected to the potentiometer.
- * @param deadZonePercent The dead zone percentage to compensate for low-precision potentiometers.
  *
- * @details Initializes the potentiometer with a dead zone and default minimum (0) and maximum (1023) values.
+ * @details Initializes the potentiometer with default minimum (0) and maximum (1023) values and no dead zone.
  */
-ATPOT::ATPOT(byte pin, float deadZonePercent)
+ATPOT::ATPOT(byte pin)
 {
-    _minVal = 0;
-    _maxVal = MAX_ANALOG_POT_READING;
-    _deadZonePercent = deadZonePercent;
-    _pin = pin;
-    _deadZoneFactor = MAX_ANALOG_POT_READING * _deadZonePercent / 100;
+    init(pin, 0, MAX_ANALOG_POT_READING, 0);
 }
 
 /**
- * @brief Basic constructor for the ATPOT class.
+ * @brief Sets up the pin, the output range and the dead zone, shared by the constructors.
  *
  * @param pin The analog pin connected to the potentiometer.
- *
- * @details Initializes the potentiometer with default minimum (0) and maximum (1023) values and no dead zone.
+ * @param minVal The minimum output value of the potentiometer.
+ * @param maxVal The maximum output value of the potentiometer.
+ * @param deadZoneTenths The dead zone in tenths of a percent of the total range (0-1023).
  */
-ATPOT::ATPOT(byte pin)
+void ATPOT::init(byte pin, int minVal, int maxVal, uint16_t deadZoneTenths)
 {
-    _minVal = 0;
-    _maxVal = MAX_ANALOG_POT_READING;
-    _deadZonePercent = 0;
+    _minVal = minVal;
+    _maxVal = maxVal;
     _pin = pin;
-    _deadZoneFactor = MAX_ANALOG_POT_READING * _deadZonePercent / 100;
+    _state = ATPOTSTATE();
+    _state.lastReading = -1; // nothing sent yet
+    setDeadZoneTenths(deadZoneTenths);
 }
 
 /**
@@ -89,13 +121,28 @@ ATPOT::ATPOT(byte pin)
  *
  * @param num The number of readings to average.
  *
- * @details This function sets the number of analog readings that will be taken and averaged
- *          in the `aRead()` function. A higher number of readings will result in a smoother,
- *          but potentially slower, response.
+ * @details This function sets the length of the moving average window used by the `aRead()`
+ *          function (1 - `ATPOT_MAX_READINGS`). A higher number of readings will result in a smoother,
+ *          but potentially slower, response. Changing it restarts the filter.
  */
 void ATPOT::setNumReadings(int num)
 {
-    _numReadings = num;
+    _numReadings = constrain(num, 1, ATPOT_MAX_READINGS);
+    restartFilter();
+}
+
+/**
+ * @brief Forgets the filter history, the next scan averages only the new samples.
+ *
+ * @details The debounced output is kept, so a position that moved while the filter was fed slowly
+ *          is reported on the first scan after the restart.
+ */
+void ATPOT::restartFilter()
+{
+    _state.sampleHead = 0;
+    _state.sampleCount = 0;
+    _state.sampleSum = 0;
+    _state.smoothedValid = false;
 }
 
 /**
@@ -109,7 +156,105 @@ void ATPOT::setNumReadings(int num)
  */
 void ATPOT::setDebounceThreshold(int threshold)
 {
-    _debounceThreshold = threshold;
+    _debounceThreshold = constrain(threshold, 0, 255);
+}
+
+/**
+ * @brief Sets the output hysteresis.
+ *
+ * @param percent How far, in percent of an output step, the position has to move past a step
+ *                boundary before the value changes (0-90, 0 disables the hysteresis).
+ *
+ * @details Converts the percentage to a distance in positions once, so `scan()` only compares.
+ */
+void ATPOT::setHysteresis(byte percent)
+{
+    _hysteresis = min(percent, 90);
+    _hysteresisMargin = hysteresisMargin(_hysteresis, abs(_maxVal - _minVal) + 1);
+}
+
+/**
+ * @brief Converts an output hysteresis to a distance in positions.
+ *
+ * @param percent How far, in percent of an output step, the position has to move past a step
+ *                boundary before the value changes (0-90).
+ * @param steps The number of output steps over the travel.
+ * @return The margin in positions (0-16383).
+ */
+uint16_t ATPOT::hysteresisMargin(byte percent, uint16_t steps)
+{
+    long step = (MAX_HIRES_POT_VALUE + 1L) / max(steps, 1);
+    return step * min(percent, 90) / 100;
+}
+
+/**
+ * @brief Checks whether the hysteresis holds an output at its current step.
+ *
+ * @param position The position of the pot (0-16383).
+ * @param margin The margin from `hysteresisMargin()`.
+ * @param last The step currently sent (0 - `steps` - 1), -1 when nothing was sent yet.
+ * @param steps The number of output steps over the travel.
+ * @return true if the position moved back by the margin in either direction is still in the
+ *         `last` step.
+ *
+ * @details A new step is only taken when the position is still outside the current one after
+ *          moving it back by the margin in either direction. Two multiplies and shifts.
+ */
+bool ATPOT::hysteresisHolds(uint16_t position, uint16_t margin, int last, uint16_t steps)
+{
+    if (!margin || last < 0) {
+        return false;
+    }
+    uint16_t below = position > margin ? position - margin : 0;
+    uint16_t above = min(position + margin, MAX_HIRES_POT_VALUE);
+    return (int)(((long)below * steps) >> 14) == last || (int)(((long)above * steps) >> 14) == last;
+}
+
+/**
+ * @brief Gets the output hysteresis.
+ *
+ * @return The hysteresis in percent of an output step.
+ */
+byte ATPOT::getHysteresis() const
+{
+    return _hysteresis;
+}
+
+/**
+ * @brief Enables or disables the adaptive smoothing filter.
+ *
+ * @param smoothing How strongly a still pedal is smoothed (1-127), 0 disables the adaptive filter.
+ * @param response How fast the smoothing opens up with pedal speed (0-127).
+ *
+ * @details The coefficient for a still pedal is computed here, so the filter itself only
+ *          multiplies and shifts. Changing the settings restarts the filter.
+ */
+void ATPOT::setAdaptive(byte smoothing, byte response)
+{
+    _smoothing = min(smoothing, 127);
+    _response = min(response, 127);
+    _alphaMin = 256 / (1 + _smoothing / 2);
+    _state.smoothedValid = false;
+}
+
+/**
+ * @brief Gets the adaptive filter smoothing.
+ *
+ * @return The smoothing (0 when the adaptive filter is disabled).
+ */
+byte ATPOT::getSmoothing() const
+{
+    return _smoothing;
+}
+
+/**
+ * @brief Gets the adaptive filter response.
+ *
+ * @return The response.
+ */
+byte ATPOT::getResponse() const
+{
+    return _response;
 }
 
 /**
@@ -117,70 +262,270 @@ void ATPOT::setDebounceThreshold(int threshold)
  *
  * @return The averaged and debounced analog reading from the potentiometer.
  *
- * @details Reads the analog value from the specified pin multiple times, calculates the average,
- *          rejects outliers (highest and lowest values), and applies debouncing.
+ * @details Feeds the new samples (one from the sampler when one is set, from the background ADC
+ *          engine when it is running on this pin, otherwise a single `analogRead()`) into the moving average filter and applies debouncing.
+ *          With the adaptive filter enabled the average then goes through an exponential average
+ *          whose coefficient is `_alphaMin` plus the distance to the smoothed value (in 10 bit
+ *          steps) times `_response / 4`, limited to 256.
  *          Debouncing prevents small fluctuations in the reading from being registered as changes.
  */
 int ATPOT::aRead()
 {
-    // debouncing was improved from gemini suggestions.
-    unsigned long startTime = millis();
-    int readings[_numReadings]; // Array to store readings
-    int total = 0;
-    int minVal = 1024; // Initialize to a value greater than the max possible reading
-    int maxVal = -1; // Initialize to a value less than the min possible reading
-    static int lastAverage = 0; // Static variable to remember the last average
-
-    for (int i = 0; i < _numReadings; i++) {
-        readings[i] = analogRead(_pin);
-        total += readings[i];
-        if (readings[i] < minVal) {
-            minVal = readings[i];
+    int8_t slot = ATADC::slot(_pin);
+    if (_sampler != nullptr) {
+        addSample(constrain(_sampler(), 0, MAX_ANALOG_POT_READING));
+    } else if (slot >= 0) {
+        while (ATADC::available(slot)) {
+            addSample(ATADC::read(slot));
         }
-        if (readings[i] > maxVal) {
-            maxVal = readings[i];
+        if (_trace != nullptr) {
+            _trace->dropped(ATADC::dropped(slot));
         }
+    } else {
+        addSample(analogRead(_pin));
     }
 
-    // Remove the highest and lowest values (outlier rejection)
-    total -= (minVal + maxVal);
+    if (!_state.sampleCount) {
+        return _state.lastAverage; // engine has just started, no samples yet
+    }
+
+    int currentAverage;
+    if (_state.highResolution) {
+        // Decimate the oversampled window (ATPOT_HIRES_READINGS samples once full) to 12 bits
+        currentAverage = ((unsigned int)_state.sampleSum << 2) / _state.sampleCount;
+    } else {
+        currentAverage = _state.sampleSum / _state.sampleCount;
+    }
+
+    if (_smoothing) {
+        long target = (long)currentAverage << 8;
+        long smoothed = _state.smoothedValid ? (long)_state.smoothed : target;
+        long distance = target - smoothed;
+        unsigned long speed = labs(distance) >> (_state.highResolution ? 10 : 8);
+        unsigned long alpha = _alphaMin + ((speed * _response) >> 2);
+        if (alpha > 256) {
+            alpha = 256;
+        }
+        smoothed += (distance * (long)alpha) >> 8;
+        _state.smoothed = smoothed;
+        _state.smoothedValid = true;
+        currentAverage = (smoothed + 128) >> 8;
+    }
 
-    // Calculate the average of the remaining readings
-    int currentAverage = total / (_numReadings - 2);
+    if (_state.calibrating) {
+        // record the travel before debouncing, which would hold the ends back
+        int reading = _state.highResolution ? currentAverage >> 2 : currentAverage;
+        _state.calibrationLow = min((int)_state.calibrationLow, reading);
+        _state.calibrationHigh = max((int)_state.calibrationHigh, reading);
+    }
 
     // Debouncing: Check if the change is significant
+    int lastAverage = _state.lastAverage;
     if (abs(currentAverage - lastAverage) < _debounceThreshold) {
         // Change is too small, consider it noise, return the last average
         return lastAverage;
     } else {
         // Significant change, update the last average and return the new average
-        lastAverage = currentAverage;
+        _state.lastAverage = currentAverage;
         return currentAverage;
     }
 }
 
+/**
+ * @brief Adds one raw sample to the filter.
+ *
+ * @param sample The raw analog reading (0-1023).
+ *
+ * @details The sample first goes through a median-of-3 outlier rejector, which removes
+ *          single sample spikes, and then into the ring buffer. The running sum is updated
+ *          by adding the new sample and subtracting the one leaving the window.
+ */
+void ATPOT::addSample(int sample)
+{
+    if (_profile != nullptr) {
+        _profile->add(sample);
+    }
+    if (_trace != nullptr) {
+        _trace->add(sample);
+    }
+    if (!_state.sampleCount) {
+        _state.history0 = sample;
+        _state.history1 = sample;
+    }
+
+    // Median of the new sample and the previous two (outlier rejection)
+    int lo = min((int)_state.history0, (int)_state.history1);
+    int hi = max((int)_state.history0, (int)_state.history1);
+    int filtered = max(lo, min(hi, sample));
+    _state.history1 = _state.history0;
+    _state.history0 = sample;
+
+    byte window = _state.highResolution ? ATPOT_HIRES_READINGS : _numReadings;
+    byte head = _state.sampleHead;
+    if (_state.sampleCount == window) {
+        _state.sampleSum -= this->sample((head - window) & (ATPOT_MAX_READINGS - 1));
+    } else {
+        _state.sampleCount++;
+    }
+    byte shift = (head & 3) * 2;
+    _state.sampleLow[head] = filtered;
+    _state.sampleHigh[head >> 2] = (_state.sampleHigh[head >> 2] & ~(3 << shift)) | ((filtered >> 8) << shift);
+    _state.sampleSum += filtered;
+    _state.sampleHead = (head + 1) & (ATPOT_MAX_READINGS - 1);
+}
+
+/**
+ * @brief Gets one sample of the window.
+ *
+ * @param index The ring buffer index (0 - `ATPOT_MAX_READINGS` - 1).
+ * @return The sample (0-1023), put together from its low byte and its top 2 bits.
+ */
+int ATPOT::sample(byte index) const
+{
+    return _state.sampleLow[index] | (((_state.sampleHigh[index >> 2] >> ((index & 3) * 2)) & 3) << 8);
+}
+
 /**
  * @brief Scans the potentiometer and updates its value.
  *
- * @details Reads the analog value, applies the dead zone, maps the value to the specified range,
- *          and triggers the `changed()` method if the value has changed.
+ * @details Reads the filtered analog value, maps it through the transfer function
+ *          (dead zone, range and curve), keeps the linear position for `shape()`, and triggers the `changed()` method if the value has changed.
+ *          With hysteresis a new value is only taken when the position is still outside the
+ *          current value's step after moving it back by the margin in either direction
+ *          (`hysteresisHolds()`, with the value's distance from `_minVal` as its step).
  *          This function should be called repeatedly in the main loop to keep the potentiometer's
  *          state updated.
  */
 void ATPOT::scan()
 {
+    unsigned long at = _eventHandler != nullptr ? micros() : 0; // only events carry a timestamp
+    int reading = aRead();
+    linearPosition = linear(reading);
+    uint16_t position = transfer(reading);
 
-    int val = aRead();
+    if (_state.highResolution) {
+        if (position != hiresValue || _state.lastReading < 0) {
+            int newValue = scale(position);
+            int oldVal = _state.lastReading;
+            if (_eventHandler != nullptr) {
+                _eventHandler({ _source, position, hiresValue, at });
+            }
+            _state.lastReading = newValue;
+            hiresValue = position;
+            rawValue = position >> 4;
+            changed(newValue, oldVal);
+        }
+        return;
+    }
 
-    val = constrain(map(val, _deadZoneFactor, MAX_ANALOG_POT_READING - _deadZoneFactor, 0, MAX_ANALOG_POT_READING), 0, MAX_ANALOG_POT_READING);
-    int newValue = map(val, 0, MAX_ANALOG_POT_READING, _minVal, _maxVal);
-    if (newValue != _lastReading) {
-        byte oldVal = _lastReading;
-        _lastReading = newValue;
-        rawValue = val;
-        changed(newValue, oldVal);
+    int newValue = scale(position);
+    int lastReading = _state.lastReading;
+    if (newValue != lastReading) {
+        if (lastReading >= 0
+            && hysteresisHolds(position, _hysteresisMargin, abs(lastReading - _minVal), abs(_maxVal - _minVal) + 1)) {
+            return; // not far enough into the next step yet
+        }
+        if (_eventHandler != nullptr) {
+            _eventHandler({ _source, (uint16_t)newValue, (uint16_t)max(lastReading, 0), at });
+        }
+        _state.lastReading = newValue;
+        rawValue = position >> 4;
+        changed(newValue, lastReading);
     }
-    //_lastReading = value;
+}
+
+/**
+ * @brief Maps a filtered reading through the transfer function.
+ *
+ * @param reading The filtered reading (0-1023, or 0-4095 in high resolution mode).
+ * @return The position of the pot after dead zone and curve (0-16383).
+ *
+ * @details The reading is clamped to the active range and scaled with one multiply by the
+ *          precomputed reciprocal (`linear()`), then interpolated between two knots of the selected
+ *          curve in flash (`shape()`). No division and no `map()` happens here.
+ */
+uint16_t ATPOT::transfer(int reading) const
+{
+    return shape(_curve, linear(reading));
+}
+
+/**
+ * @brief Maps a filtered reading to its place on the travel, without the curve.
+ *
+ * @param reading The filtered reading (0-1023, or 0-4095 in high resolution mode).
+ * @return The position of the pot after travel and dead zone (0-16383), linear.
+ *
+ * @details One multiply by the precomputed reciprocal, the curve segment (32 segments with
+ *          9 fraction bits) is already a 14 bit linear position.
+ */
+uint16_t ATPOT::linear(int reading) const
+{
+    if (reading <= _rawLow) {
+        return 0;
+    }
+    if (reading >= _rawHigh) {
+        return MAX_HIRES_POT_VALUE;
+    }
+    uint32_t index = ((uint32_t)(reading - _rawLow) * _lutScale) >> 15; // 9 bit fraction
+    return min(index, (uint32_t)MAX_HIRES_POT_VALUE);
+}
+
+/**
+ * @brief Shapes a linear position with one of the built-in curves.
+ *
+ * @param curve One of `ATPOT_CURVE_LINEAR` ... `ATPOT_CURVE_REVERSE`, out of range values select linear.
+ * @param position The linear position (0-16383).
+ * @return The shaped position (0-16383).
+ *
+ * @details Two words from flash and one multiply. Each of the 32 segments covers 512 positions.
+ */
+uint16_t ATPOT::shape(byte curve, uint16_t position)
+{
+    const uint16_t* knots = CURVES[curve < ATPOT_CURVE_COUNT ? curve : ATPOT_CURVE_LINEAR];
+    if (position >= MAX_HIRES_POT_VALUE) {
+        return pgm_read_word(&knots[ATPOT_LUT_SEGMENTS]); // the toe end reaches the last knot
+    }
+    byte segment = position >> 9;
+    uint16_t fraction = position & 0x1FF;
+    int low = pgm_read_word(&knots[segment]);
+    int delta = (int)pgm_read_word(&knots[segment + 1]) - low;
+    return low + (int)(((long)delta * fraction) >> 9);
+}
+
+/**
+ * @brief Scales a position to the output range.
+ *
+ * @param position The position of the pot (0-16383).
+ * @return The value between `_minVal` and `_maxVal`.
+ *
+ * @details Every output step covers the same share of the travel. One multiply and a shift.
+ */
+int ATPOT::scale(uint16_t position) const
+{
+    if (_maxVal >= _minVal) {
+        return _minVal + (int)(((long)position * (_maxVal - _minVal + 1)) >> 14);
+    }
+    return _minVal - (int)(((long)position * (_minVal - _maxVal + 1)) >> 14);
+}
+
+/**
+ * @brief Recomputes the active reading range and its reciprocal.
+ *
+ * @details Computes the dead zone in 10 bit steps from each end of the travel, the active reading
+ *          range from the travel, the dead zone and the resolution, and the reciprocal used to find
+ *          the curve segment. This is the only place that divides, and it only runs when the dead
+ *          zone, the travel, the resolution or the configuration changes.
+ */
+void ATPOT::buildTransfer()
+{
+    int deadZone = (long)(_travelHigh - _travelLow) * _deadZoneTenths / (100 * ATPOT_DEADZONE_SCALE);
+    byte shift = _state.highResolution ? 2 : 0; // 10 bit travel to 12 bit readings
+    _rawLow = (_travelLow + deadZone) << shift;
+    _rawHigh = ((_travelHigh - deadZone + 1) << shift) - 1;
+    if (_rawHigh <= _rawLow) {
+        _rawHigh = _rawLow + 1;
+    }
+    _lutScale = ((uint32_t)ATPOT_LUT_SEGMENTS << 24) / (_rawHigh - _rawLow);
 }
 
 /**
@@ -224,26 +569,245 @@ void ATPOT::setChangeHandler(void (*handler)(byte, byte))
 }
 
 /**
- * @brief Sets the dead zone percentage for the potentiometer.
+ * @brief Sets the event handler function.
+ *
+ * @param handler A pointer to the function called with an `ATEVENT` whenever the value changes, or nullptr.
+ */
+void ATPOT::setEventHandler(void (*handler)(const ATEVENT&))
+{
+    _eventHandler = handler;
+}
+
+/**
+ * @brief Sets the source id carried by the pot's events.
  *
- * @param deadZonePercent The new dead zone percentage.
+ * @param source The id.
+ */
+void ATPOT::setSource(byte source)
+{
+    _source = source;
+}
+
+/**
+ * @brief Gets the source id carried by the pot's events.
  *
- * @details Updates the dead zone percentage and recalculates the dead zone factor.
+ * @return The id.
  */
-void ATPOT::setDeadZone(float deadZonePercent)
+byte ATPOT::getSource() const
 {
-    _deadZonePercent = deadZonePercent;
-    _deadZoneFactor = MAX_ANALOG_POT_READING * _deadZonePercent / 100;
+    return _source;
 }
 
 /**
- * @brief Gets the current dead zone percentage.
+ * @brief Replaces the pin with a sample generator.
  *
- * @return The current dead zone percentage.
+ * @param sampler A function returning one raw reading per scan, or nullptr to read the pin again.
+ *
+ * @details The filter keeps its history, so the first scans after switching blend the two sources.
  */
-float ATPOT::getDeadZone() const
+void ATPOT::setSampler(int (*sampler)())
 {
-    return _deadZonePercent;
+    _sampler = sampler;
+}
+
+/**
+ * @brief Feeds every raw sample into a noise profile.
+ *
+ * @param profile The profile, or nullptr to stop profiling.
+ *
+ * @details The samples are taken before the spike rejector, so the profile sees the real noise.
+ */
+void ATPOT::setProfile(ATPOTNOISE* profile)
+{
+    _profile = profile;
+}
+
+/**
+ * @brief Records every raw sample into a trace.
+ *
+ * @param trace The trace, or nullptr to stop recording.
+ */
+void ATPOT::setTrace(ATTRACE* trace)
+{
+    _trace = trace;
+}
+
+/**
+ * @brief Sets the dead zone in tenths of a percent, without float math.
+ *
+ * @param tenths The dead zone (0-1000).
+ *
+ * @details Updates the dead zone and recomputes the active range from the travel.
+ */
+void ATPOT::setDeadZoneTenths(uint16_t tenths)
+{
+    _deadZoneTenths = min(tenths, 100 * ATPOT_DEADZONE_SCALE);
+    buildTransfer();
+}
+
+/**
+ * @brief Gets the dead zone in tenths of a percent.
+ *
+ * @return The dead zone (0-1000).
+ */
+uint16_t ATPOT::getDeadZoneTenths() const
+{
+    return _deadZoneTenths;
+}
+
+/**
+ * @brief Sets the real travel of the pot, the raw readings at both ends.
+ *
+ * @param low The reading at the heel end (0-1023).
+ * @param high The reading at the toe end (0-1023).
+ *
+ * @details The dead zone percentage is taken from the new travel, then the active range is recomputed.
+ */
+void ATPOT::setTravel(int low, int high)
+{
+    low = constrain(low, 0, MAX_ANALOG_POT_READING);
+    high = constrain(high, 0, MAX_ANALOG_POT_READING);
+    if (high - low < ATPOT_MIN_TRAVEL) {
+        low = 0;
+        high = MAX_ANALOG_POT_READING;
+    }
+    _travelLow = low;
+    _travelHigh = high;
+    setDeadZoneTenths(_deadZoneTenths);
+}
+
+/**
+ * @brief Gets the reading at the heel end of the travel.
+ *
+ * @return The low endpoint (0-1023).
+ */
+int ATPOT::getTravelLow() const
+{
+    return _travelLow;
+}
+
+/**
+ * @brief Gets the reading at the toe end of the travel.
+ *
+ * @return The high endpoint (0-1023).
+ */
+int ATPOT::getTravelHigh() const
+{
+    return _travelHigh;
+}
+
+/**
+ * @brief Starts recording the travel of the pot.
+ *
+ * @details The recorded range starts empty, the first filtered reading opens it.
+ */
+void ATPOT::beginCalibration()
+{
+    _state.calibrationLow = MAX_ANALOG_POT_READING;
+    _state.calibrationHigh = 0;
+    _state.calibrating = true;
+}
+
+/**
+ * @brief Stops recording and takes the recorded travel.
+ *
+ * @return true if the recorded travel covers at least `ATPOT_MIN_TRAVEL` steps and was taken,
+ *         false if the current travel was kept.
+ */
+bool ATPOT::endCalibration()
+{
+    if (!_state.calibrating) {
+        return false;
+    }
+    _state.calibrating = false;
+    if (_state.calibrationHigh - _state.calibrationLow < ATPOT_MIN_TRAVEL) {
+        return false;
+    }
+    setTravel(_state.calibrationLow, _state.calibrationHigh);
+    return true;
+}
+
+/**
+ * @brief Checks whether the travel is being recorded.
+ *
+ * @return true between `beginCalibration()` and `endCalibration()`.
+ */
+bool ATPOT::isCalibrating() const
+{
+    return _state.calibrating;
+}
+
+/**
+ * @brief Enables or disables the high resolution mode.
+ *
+ * @param enabled true to oversample the ADC to 12 bits and produce a 14 bit `hiresValue`.
+ *
+ * @details Recomputes the active range for the new reading width and restarts the filter (the
+ *          window length changes), debouncing and change detection, so the next scan reports the
+ *          current position in the new resolution.
+ */
+void ATPOT::setHighResolution(bool enabled)
+{
+    if (enabled == _state.highResolution) {
+        return;
+    }
+    _state.highResolution = enabled;
+    _state.lastAverage = 0;
+    _state.lastReading = -1;
+    restartFilter();
+    buildTransfer();
+}
+
+/**
+ * @brief Checks whether the high resolution mode is enabled.
+ *
+ * @return true if the high resolution mode is enabled.
+ */
+bool ATPOT::isHighResolution() const
+{
+    return _state.highResolution;
+}
+
+/**
+ * @brief Restarts change detection, so the next scan reports the current position again.
+ */
+void ATPOT::refresh()
+{
+    _state.lastReading = -1;
+}
+
+/**
+ * @brief Selects the response curve.
+ *
+ * @param curve One of `ATPOT_CURVE_LINEAR` ... `ATPOT_CURVE_REVERSE`, out of range values select linear.
+ *
+ * @details The curve is read from flash on every scan, nothing has to be rebuilt. Change detection
+ *          keeps running, so the next scan reports the position on the new curve.
+ */
+void ATPOT::setCurve(byte curve)
+{
+    _curve = curve < ATPOT_CURVE_COUNT ? curve : ATPOT_CURVE_LINEAR;
+    buildTransfer();
+}
+
+/**
+ * @brief Gets the selected response curve.
+ *
+ * @return The selected curve (`ATPOT_CURVE_LINEAR` ... `ATPOT_CURVE_REVERSE`).
+ */
+byte ATPOT::getCurve() const
+{
+    return _curve;
+}
+
+/**
+ * @brief Gets the analog pin of the potentiometer.
+ *
+ * @return The analog pin connected to the potentiometer.
+ */
+byte ATPOT::getPin() const
+{
+    return _pin;
 }
 
 /**
@@ -298,18 +862,32 @@ void ATMIDICCPOT::INIT(byte ch, byte cc)
  *          It also sets the MIDI channel and CC number.
  */
 ATMIDICCPOT::ATMIDICCPOT(byte pin, byte ch, byte cc)
-    : ATPOT { pin, 0, 127, 1 }
+    : ATPOT { pin, 0, 127 }
 {
+    setDeadZoneTenths(1 * ATPOT_DEADZONE_SCALE);
     INIT(ch, cc);
 }
 
+/**
+ * @brief Sends the messages through a non-blocking DIN MIDI writer.
+ *
+ * @param out The writer, or nullptr to write to `Serial` directly.
+ */
+void ATMIDICCPOT::setOutput(ATDINMIDI* out)
+{
+    _out = out;
+}
+
 /**
  * @brief Overrides the `changed()` method to send MIDI CC messages.
  *
  * @details This method is called when the potentiometer's value changes.
  *          It sends a MIDI CC message with the assigned CC number and the mapped value.
  *          If a custom value array is used, the mapped index in the array is used as the value.
- *          The MIDI message is sent over the hardware serial port.
+ *          In high resolution mode (CC 0-31 without a value array) the MSB is sent on the assigned CC
+ *          and the LSB on CC + 32.
+ *          The MIDI message is queued on the `setOutput()` writer, or written to the serial port
+ *          when none is set.
  */
 void ATMIDICCPOT::changed(byte newValue, byte oldValue)
 {
@@ -317,15 +895,220 @@ void ATMIDICCPOT::changed(byte newValue, byte oldValue)
     byte _value = newValue;
 
     if (valueType) {
-        byte index = map(newValue, 0, 127, 0, _count - 1);
+        byte index = (unsigned)newValue * (_count - 1) / 127; // as map(newValue, 0, 127, 0, _count - 1)
         _value = _varr[index];
     }
-    Serial.write(_mesg);
-    Serial.write(_cc);
-    Serial.write(constrain(_value, 0, 127));
+    if (_out != nullptr) {
+        byte ch = (_mesg & 0x0F) + 1;
+        if (_state.highResolution && !valueType && _cc < 32) {
+            _out->controlChange14(_cc, hiresValue, ch);
+        } else {
+            _out->controlChange(_cc, constrain(_value, 0, 127), ch);
+        }
+    } else if (_state.highResolution && !valueType && _cc < 32) {
+        Serial.write(_mesg);
+        Serial.write(_cc);
+        Serial.write(hiresValue >> 7);
+        Serial.write(_mesg);
+        Serial.write(_cc + 32);
+        Serial.write(hiresValue & 0x7F);
+    } else {
+        Serial.write(_mesg);
+        Serial.write(_cc);
+        Serial.write(constrain(_value, 0, 127));
+    }
 
     if (_changeHandler != nullptr) {
         _changeHandler(_value, oldValue); // Call the registered handler
         reset();
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Constructor for the ATPOTBANK class.
+ *
+ * @param pots Array of pointers to the pots of the bank.
+ * @param count The number of pots in the array (at most `ATADC_MAX_CHANNELS`).
+ *
+ * @details Pots past `ATADC_MAX_CHANNELS` are left out of the bank.
+ */
+ATPOTBANK::ATPOTBANK(ATPOT** pots, byte count)
+{
+    _pots = pots;
+    _count = min(count, ATADC_MAX_CHANNELS);
+}
+
+/**
+ * @brief Starts background sampling of all the pots in the bank.
+ *
+ * @details Collects the pins of the pots and hands them to `ATADC`, which round-robins
+ *          the multiplexer between them. Each pot's index in the bank becomes its event source id.
+ */
+void ATPOTBANK::begin()
+{
+    byte pins[ATADC_MAX_CHANNELS];
+    for (byte i = 0; i < _count; i++) {
+        pins[i] = _pots[i]->getPin();
+        _pots[i]->setSource(i);
+    }
+    ATADC::begin(pins, _count);
+}
+
+/**
+ * @brief Scans all the pots in the bank.
+ *
+ * @details Every pot only consumes the samples of its own channel that arrived since the last
+ *          scan, so the cost per pot does not grow with the number of pots.
+ */
+void ATPOTBANK::scan()
+{
+    for (byte i = 0; i < _count; i++) {
+        _pots[i]->scan();
+    }
+}
+
+/**
+ * @brief Gets the number of pots in the bank.
+ *
+ * @return The number of pots.
+ */
+byte ATPOTBANK::count() const
+{
+    return _count;
+}
+
+/**
+ * @brief Square root of an integer, rounded down.
+ */
+static uint16_t isqrt(unsigned long x)
+{
+    unsigned long root = 0;
+    unsigned long bit = 1UL << 30;
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+/**
+ * @brief Constructor for the ATPOTNOISE class, starts with an empty profile.
+ */
+ATPOTNOISE::ATPOTNOISE()
+{
+    reset();
+}
+
+/**
+ * @brief Clears the profile.
+ */
+void ATPOTNOISE::reset()
+{
+    count = 0;
+    _first = 0;
+    _low = MAX_ANALOG_POT_READING;
+    _high = 0;
+    _sum = 0;
+    _sumSquares = 0;
+}
+
+/**
+ * @brief Adds one raw sample.
+ *
+ * @param sample The reading (0-1023).
+ *
+ * @details The sums are kept of the distance to the first sample, small at rest, so they do not
+ *          overflow on a long profile. Samples past 65535 are ignored.
+ */
+void ATPOTNOISE::add(int sample)
+{
+    if (count == 0xFFFF) {
+        return;
+    }
+    if (!count) {
+        _first = sample;
+    }
+    long distance = sample - _first;
+    count++;
+    _low = min(_low, sample);
+    _high = max(_high, sample);
+    _sum += distance;
+    _sumSquares += distance * distance;
+}
+
+/**
+ * @brief Checks whether the profile is usable.
+ *
+ * @return true with at least `ATPOT_PROFILE_MIN_SAMPLES` samples within `ATPOT_PROFILE_MAX_SPREAD`.
+ */
+bool ATPOTNOISE::atRest() const
+{
+    return count >= ATPOT_PROFILE_MIN_SAMPLES && spread() <= ATPOT_PROFILE_MAX_SPREAD;
+}
+
+/**
+ * @brief Gets the spread of the samples (highest - lowest).
+ *
+ * @return The spread in 10 bit steps, 0 when nothing was added.
+ */
+uint16_t ATPOTNOISE::spread() const
+{
+    return count ? _high - _low : 0;
+}
+
+/**
+ * @brief Variance of the samples in 1/256 of a squared 10 bit step.
+ *
+ * @details Divides before scaling to 8 fraction bits, with the remainder scaled separately, so
+ *          no intermediate outgrows 32 bits for any sum `add()` can reach at rest: up to 65535
+ *          samples at a distance of up to `ATPOT_PROFILE_MAX_SPREAD`.
+ */
+unsigned long ATPOTNOISE::variance() const
+{
+    if (count < 2) {
+        return 0;
+    }
+    long mean256 = (_sum / count) * 256 + ((_sum % count) * 256) / count; // mean distance, 8 fraction bits
+    unsigned long meanSquare256 = ((_sumSquares / count) << 8) + (((_sumSquares % count) << 8) / count);
+    unsigned long square256 = (unsigned long)((mean256 * mean256) >> 8);
+    return meanSquare256 > square256 ? meanSquare256 - square256 : 0;
+}
+
+/**
+ * @brief Gets the standard deviation of the samples.
+ *
+ * @return The standard deviation in 1/16 of a 10 bit step.
+ */
+uint16_t ATPOTNOISE::deviation() const
+{
+    return isqrt(variance());
+}
+
+/**
+ * @brief Picks the filter settings for the measured noise.
+ *
+ * @param readings Receives the moving average window (1 - `ATPOT_MAX_READINGS`).
+ * @param threshold Receives the debounce threshold (1-255).
+ *
+ * @details Works on squares, in 1/256 of a step: 36 variances is the squared peak to peak noise
+ *          of a single sample.
+ */
+void ATPOTNOISE::tune(byte& readings, byte& threshold) const
+{
+    unsigned long peak256 = 36 * variance();
+    unsigned long target256 = (unsigned long)ATPOT_PROFILE_TARGET * ATPOT_PROFILE_TARGET << 8;
+    unsigned long window = (peak256 + target256 - 1) / target256;
+    readings = constrain(window, 1, ATPOT_MAX_READINGS);
+
+    uint16_t left = isqrt((peak256 / readings) >> 8); // peak to peak noise of the average
+    threshold = min(left + 1, spread() + 1);
+    threshold = constrain(threshold, 1, 255);
+}
@@ -11,8 +11,197 @@
 #ifndef ATPOTS_H
 #define ATPOTS_H // Corrected the macro name to be consistent
 #define MAX_ANALOG_POT_READING 1023
+#ifndef ATPOT_MAX_READINGS
+/** @brief Capacity of the per-pot sample ring buffer (4, 8, 16 or 32), 10 bits of RAM per sample and pot. */
+#define ATPOT_MAX_READINGS 16
+#endif
+/**
+ * @brief RAM one `ATPOT` takes on the 32u4 (bytes): 65 plus 10 bits per sample of the window.
+ *
+ * @details Checked against `sizeof` when building for AVR and reported by the build (ATPOTS.cpp).
+ *          `ATMIDICCPOT` takes `ATMIDICCPOT_EXTRA_BYTES` more.
+ */
+#if ATPOT_MAX_READINGS == 4
+#define ATPOT_BYTES 70
+#elif ATPOT_MAX_READINGS == 8
+#define ATPOT_BYTES 75
+#elif ATPOT_MAX_READINGS == 16
+#define ATPOT_BYTES 85
+#elif ATPOT_MAX_READINGS == 32
+#define ATPOT_BYTES 105
+#else
+#error "ATPOT_MAX_READINGS is 4, 8, 16 or 32"
+#endif
+/** @brief RAM `ATMIDICCPOT` adds to `ATPOT` on the 32u4 (bytes). */
+#define ATMIDICCPOT_EXTRA_BYTES 8
+/**
+ * @brief Moving average window of the high resolution mode: 4^2 samples for the 2 extra bits of a
+ *        12 bit reading, or the whole buffer when it is built smaller (fewer real bits).
+ */
+#if ATPOT_MAX_READINGS >= 16
+#define ATPOT_HIRES_READINGS 16
+#else
+#define ATPOT_HIRES_READINGS ATPOT_MAX_READINGS
+#endif
+/** @brief Fixed point scale of the dead zone: it is kept in tenths of a percent. */
+#define ATPOT_DEADZONE_SCALE 10
+/** @brief Full scale of the oversampled reading in high resolution mode (12 bit). */
+#define MAX_HIRES_POT_READING 4095
+/** @brief Full scale of the 14 bit value sent in high resolution mode. */
+#define MAX_HIRES_POT_VALUE 16383
+/** @brief Smallest travel (in 10 bit steps) a calibration must cover to be taken. */
+#define ATPOT_MIN_TRAVEL 100
+/** @brief Number of segments of the built-in response curves (must be a power of two). */
+#define ATPOT_LUT_SEGMENTS 32
+/** @brief Response curve: the output follows the pedal travel. */
+#define ATPOT_CURVE_LINEAR 0
+/** @brief Response curve: fast rise at the heel, fine control at the toe (volume). */
+#define ATPOT_CURVE_LOG 1
+/** @brief Response curve: slow start at the heel, fast rise at the toe. */
+#define ATPOT_CURVE_EXP 2
+/** @brief Response curve: fine control at both ends, fast through the middle (wah). */
+#define ATPOT_CURVE_SCURVE 3
+/** @brief Response curve: linear, from maximum at the heel to minimum at the toe. */
+#define ATPOT_CURVE_REVERSE 4
+/** @brief Number of built-in response curves. */
+#define ATPOT_CURVE_COUNT 5
+/** @brief Largest raw spread (10 bit steps) a noise profile may show and still count as taken at rest. */
+#define ATPOT_PROFILE_MAX_SPREAD 32
+/** @brief Fewest samples a noise profile needs. */
+#define ATPOT_PROFILE_MIN_SAMPLES 64
+/** @brief Peak to peak noise (10 bit steps) the tuned window brings the average down to. */
+#define ATPOT_PROFILE_TARGET 4
+#include "ATADC.h"
+#include "ATQUEUE.h"
 #include <Arduino.h>
 
+class ATDINMIDI;
+class ATTRACE;
+
+/**
+ * @brief Noise profile of a pot at rest, and the filter settings it calls for.
+ *
+ * @details Collects the raw samples handed to it by `ATPOT::setProfile()`: their spread and, from
+ *          the sum and sum of squares of their distance to the first sample, their variance, all
+ *          in integers. Only needed while profiling, the pot keeps a pointer to it.
+ */
+class ATPOTNOISE {
+
+public:
+    /**
+     * @brief Constructor for the ATPOTNOISE class, starts with an empty profile.
+     */
+    ATPOTNOISE();
+
+    /**
+     * @brief Clears the profile.
+     */
+    void reset();
+
+    /**
+     * @brief Adds one raw sample.
+     *
+     * @param sample The reading (0-1023).
+     */
+    void add(int sample);
+
+    /**
+     * @brief Checks whether the profile is usable.
+     *
+     * @return true with at least `ATPOT_PROFILE_MIN_SAMPLES` samples within `ATPOT_PROFILE_MAX_SPREAD`.
+     */
+    bool atRest() const;
+
+    /**
+     * @brief Gets the spread of the samples (highest - lowest).
+     *
+     * @return The spread in 10 bit steps, 0 when nothing was added.
+     */
+    uint16_t spread() const;
+
+    /**
+     * @brief Gets the standard deviation of the samples.
+     *
+     * @return The standard deviation in 1/16 of a 10 bit step.
+     */
+    uint16_t deviation() const;
+
+    /**
+     * @brief Picks the filter settings for the measured noise.
+     *
+     * @param readings Receives the moving average window (1 - `ATPOT_MAX_READINGS`).
+     * @param threshold Receives the debounce threshold (1-255).
+     *
+     * @details The peak to peak noise of an n sample average is about 6 standard deviations
+     *          divided by the square root of n. The window is the shortest that brings it down to
+     *          `ATPOT_PROFILE_TARGET`, the threshold the first step above the noise left in it, but
+     *          never above what the raw spread allows.
+     */
+    void tune(byte& readings, byte& threshold) const;
+
+    /**
+     * @brief Number of samples added.
+     */
+    uint16_t count;
+
+private:
+    /**
+     * @brief Variance of the samples in 1/256 of a squared 10 bit step.
+     */
+    unsigned long variance() const;
+
+    int _first;
+    int _low;
+    int _high;
+    long _sum;
+    unsigned long _sumSquares;
+};
+
+/**
+ * @brief Filter and change detection state of one pot, every field at the width it needs.
+ *
+ * @details The samples are 10 bit readings: their low bytes are kept apart from their top 2 bits,
+ *          which are packed 4 to a byte, and the smaller fields share bit fields. Each group of
+ *          bit fields fills its unit, so the layout is the same on every compiler. On the 32u4 the
+ *          state takes 16 bytes plus 10 bits per sample of the window.
+ */
+struct ATPOTSTATE {
+    /** @brief Low 8 bits of the samples in the moving average window. */
+    byte sampleLow[ATPOT_MAX_READINGS];
+    /** @brief Top 2 bits of the samples, 4 samples per byte, the first one in the low bits. */
+    byte sampleHigh[ATPOT_MAX_READINGS / 4];
+    /** @brief Running sum of the samples in the window. */
+    uint16_t sampleSum;
+    /** @brief The last value sent (between `_minVal` and `_maxVal`), -1 when nothing was sent yet. */
+    int lastReading;
+    /** @brief The adaptive filter state, the smoothed reading with 8 fraction bits (0 - 4095 x 256). */
+    uint32_t smoothed : 20;
+    /** @brief The last average that passed the debounce threshold (0-4095). */
+    uint32_t lastAverage : 12;
+    /** @brief The newest raw sample, for the median-of-3 outlier rejector. */
+    uint16_t history0 : 10;
+    /** @brief Index where the next sample will be written. */
+    uint16_t sampleHead : 5;
+    /** @brief Whether `smoothed` holds a value, the adaptive filter restarts from the next average without. */
+    uint16_t smoothedValid : 1;
+    /** @brief The raw sample before `history0`. */
+    uint16_t history1 : 10;
+    /** @brief Number of valid samples in the window (up to `ATPOT_MAX_READINGS`). */
+    uint16_t sampleCount : 6;
+    /** @brief Lowest reading (10 bit) seen since `beginCalibration()`. */
+    uint16_t calibrationLow : 10;
+    /** @brief Whether the high resolution mode is enabled. */
+    uint16_t highResolution : 1;
+    /** @brief Whether `aRead()` records the travel. */
+    uint16_t calibrating : 1;
+    uint16_t : 4;
+    /** @brief Highest reading (10 bit) seen since `beginCalibration()`. */
+    uint16_t calibrationHigh : 10;
+    uint16_t : 6;
+};
+static_assert((ATPOT_MAX_READINGS & (ATPOT_MAX_READINGS - 1)) == 0 && ATPOT_MAX_READINGS >= 4 && ATPOT_MAX_READINGS <= 32,
+    "ATPOTSTATE packs 4 samples per top bits byte and counts at most 32 of them");
+
 /**
  * @brief Represents a generic potentiometer connected to an analog pin.
  *
@@ -32,9 +221,13 @@ public:
      * @param deadZonePercent The dead zone percentage to compensate for low-precision potentiometers (0.0 - 100.0).
      *
      * @details Initializes the potentiometer with custom minimum and maximum values, and a dead zone.
-     *          The dead zone is calculated as a percentage of the total range (0-1023).
+     *          The dead zone is calculated as a percentage of the total range (0-1023). Inline, so a
+     *          constant percentage is converted at compile time and no float code is linked.
      */
-    ATPOT(byte pin, int minVal, int maxVal, float deadZonePercent);
+    ATPOT(byte pin, int minVal, int maxVal, float deadZonePercent)
+    {
+        init(pin, minVal, maxVal, toTenths(deadZonePercent));
+    }
 
     /**
      * @brief Constructor for the ATPOT class with a dead zone and default minimum/maximum values.
@@ -44,7 +237,10 @@ public:
      *
      * @details Initializes the potentiometer with a dead zone and default minimum (0) and maximum (1023) values.
      */
-    ATPOT(byte pin, float deadZonePercent);
+    ATPOT(byte pin, float deadZonePercent)
+    {
+        init(pin, 0, MAX_ANALOG_POT_READING, toTenths(deadZonePercent));
+    }
 
     /**
      * @brief Constructor for the ATPOT class with custom minimum and maximum values and a dead zone.
@@ -57,7 +253,22 @@ public:
      * @details Initializes the potentiometer with custom minimum and maximum values, and a dead zone.
      *          The dead zone is calculated as a percentage of the total range (0-1023).
      */
-    ATPOT(byte pin, int minVal, int maxVal, float deadZonePercent, void (*handler)(byte, byte));
+    ATPOT(byte pin, int minVal, int maxVal, float deadZonePercent, void (*handler)(byte, byte))
+    {
+        init(pin, minVal, maxVal, toTenths(deadZonePercent));
+        setChangeHandler(handler);
+    }
+
+    /**
+     * @brief Constructor for the ATPOT class with custom minimum and maximum values and no dead zone.
+     *
+     * @param pin The analog pin connected to the potentiometer.
+     * @param minVal The minimum output value of the potentiometer.
+     * @param maxVal The maximum output value of the potentiometer.
+     *
+     * @details For sketches without any float code, set the dead zone with `setDeadZoneTenths()`.
+     */
+    ATPOT(byte pin, int minVal, int maxVal);
 
     /**
      * @brief Basic constructor for the ATPOT class with default minimum/maximum values and no dead zone.
@@ -73,16 +284,35 @@ public:
      *
      * @param num The number of readings to average.
      *
-     * @details This function sets the number of analog readings that will be taken and averaged
-     *          in the `aRead()` function. A higher number of readings will result in a smoother,
-     *          but potentially slower, response.
+     * @details This function sets the length of the moving average window used by the `aRead()`
+     *          function (1 - `ATPOT_MAX_READINGS`). A higher number of readings will result in a smoother,
+     *          but potentially slower, response. Changing it restarts the filter. The high resolution
+     *          mode uses its own window (`ATPOT_HIRES_READINGS`), this one applies again without it.
      */
     void setNumReadings(int num);
 
+    /**
+     * @brief Forgets the filter history, the next scan averages only the new samples.
+     *
+     * @details For a pot that was sampled slowly (see `ATADC::pause()`) and is back at full rate.
+     */
+    void restartFilter();
+
+    /**
+     * @brief Converts a dead zone percentage to the fixed point dead zone.
+     *
+     * @param percent The dead zone percentage (0.0 - 100.0).
+     * @return The dead zone in tenths of a percent (0-1000).
+     */
+    static constexpr uint16_t toTenths(float percent)
+    {
+        return percent <= 0 ? 0 : percent >= 100 ? 100 * ATPOT_DEADZONE_SCALE : (uint16_t)(percent * ATPOT_DEADZONE_SCALE + 0.5f);
+    }
+
     /**
      * @brief Sets the debounce threshold for the potentiometer.
      *
-     * @param threshold The debounce threshold value.
+     * @param threshold The debounce threshold value (0-255).
      *
      * @details This function sets the threshold used for debouncing in the `aRead()` function.
      *          The debounce threshold determines how much the reading must change before it is
@@ -90,11 +320,61 @@ public:
      */
     void setDebounceThreshold(int threshold);
 
+    /**
+     * @brief Sets the output hysteresis.
+     *
+     * @param percent How far, in percent of an output step, the position has to move past a step
+     *                boundary before the value changes (0-90, 0 disables the hysteresis).
+     *
+     * @details Unlike a bigger debounce threshold this does not delay a sweep, the value still
+     *          changes on the first reading that is far enough into the next step. A reading
+     *          resting on a step boundary no longer flips between the two values. With 50 the
+     *          position has to reach the middle of the next step. Only the 7 bit value is held
+     *          back, in high resolution mode the debounce threshold still decides.
+     */
+    void setHysteresis(byte percent);
+
+    /**
+     * @brief Enables or disables the adaptive smoothing filter.
+     *
+     * @param smoothing How strongly a still pedal is smoothed (1-127), 0 disables the adaptive filter.
+     * @param response How fast the smoothing opens up with pedal speed (0-127).
+     *
+     * @details A fixed point exponential average follows the moving average. Its coefficient
+     *          grows with the distance between the new average and the smoothed value, so a still
+     *          pedal is smoothed heavily (a time constant of up to 64 scans at smoothing 127) while
+     *          a fast sweep passes with nearly no lag. A bigger `response` reaches the full
+     *          coefficient at a lower speed.
+     */
+    void setAdaptive(byte smoothing, byte response);
+
+    /**
+     * @brief Gets the adaptive filter smoothing.
+     *
+     * @return The smoothing (0 when the adaptive filter is disabled).
+     */
+    byte getSmoothing() const;
+
+    /**
+     * @brief Gets the adaptive filter response.
+     *
+     * @return The response.
+     */
+    byte getResponse() const;
+
+    /**
+     * @brief Gets the output hysteresis.
+     *
+     * @return The hysteresis in percent of an output step.
+     */
+    byte getHysteresis() const;
+
     /**
      * @brief Scans the potentiometer and updates its value.
      *
-     * @details Reads the analog value, applies the dead zone, maps the value to the specified range,
-     *          and triggers the `changed()` method if the value has changed.
+     * @details Reads the filtered analog value, maps it through the transfer function
+     *          (dead zone, range and curve) and triggers the `changed()` method if the value has changed
+     *          by more than the hysteresis.
      *          This function should be called repeatedly in the main loop to keep the potentiometer's
      *          state updated.
      */
@@ -105,16 +385,209 @@ public:
      *
      * @param deadZonePercent The new dead zone percentage (0.0 - 100.0).
      *
-     * @details Updates the dead zone percentage and recalculates the dead zone factor.
+     * @details Updates the dead zone percentage and recomputes the active range.
+     *          The percentage is taken from the travel (see `setTravel()`) and cut off at both ends of it.
+     *          Inline wrapper of `setDeadZoneTenths()`, the float math is only linked when it is used.
      */
-    void setDeadZone(float deadZonePercent);
+    void setDeadZone(float deadZonePercent)
+    {
+        setDeadZoneTenths(toTenths(deadZonePercent));
+    }
 
     /**
      * @brief Gets the current dead zone percentage.
      *
      * @return The current dead zone percentage.
      */
-    float getDeadZone() const; // Added const
+    float getDeadZone() const
+    {
+        return _deadZoneTenths / (float)ATPOT_DEADZONE_SCALE;
+    }
+
+    /**
+     * @brief Sets the dead zone in tenths of a percent, without float math.
+     *
+     * @param tenths The dead zone (0-1000, 100 is 10%).
+     *
+     * @details Same as `setDeadZone()`: recomputes the active range from the travel.
+     */
+    void setDeadZoneTenths(uint16_t tenths);
+
+    /**
+     * @brief Gets the dead zone in tenths of a percent.
+     *
+     * @return The dead zone (0-1000).
+     */
+    uint16_t getDeadZoneTenths() const;
+
+    /**
+     * @brief Sets the real travel of the pot, the raw readings at both ends.
+     *
+     * @param low The reading at the heel end (0-1023).
+     * @param high The reading at the toe end (0-1023).
+     *
+     * @details The dead zone and the transfer function then cover only this travel, so the whole
+     *          travel maps onto every output step. Endpoints that are less than `ATPOT_MIN_TRAVEL`
+     *          apart (or swapped) select the full range 0-1023 instead.
+     */
+    void setTravel(int low, int high);
+
+    /**
+     * @brief Gets the reading at the heel end of the travel.
+     *
+     * @return The low endpoint (0-1023).
+     */
+    int getTravelLow() const;
+
+    /**
+     * @brief Gets the reading at the toe end of the travel.
+     *
+     * @return The high endpoint (0-1023).
+     */
+    int getTravelHigh() const;
+
+    /**
+     * @brief Starts recording the travel of the pot.
+     *
+     * @details Every following scan records the lowest and highest filtered reading, while the pot
+     *          keeps working on the current travel. Sweep the pot end to end, then call
+     *          `endCalibration()`.
+     */
+    void beginCalibration();
+
+    /**
+     * @brief Stops recording and takes the recorded travel.
+     *
+     * @return true if the recorded travel covers at least `ATPOT_MIN_TRAVEL` steps and was taken,
+     *         false if the current travel was kept.
+     */
+    bool endCalibration();
+
+    /**
+     * @brief Checks whether the travel is being recorded.
+     *
+     * @return true between `beginCalibration()` and `endCalibration()`.
+     */
+    bool isCalibrating() const;
+
+    /**
+     * @brief Enables or disables the high resolution mode.
+     *
+     * @param enabled true to oversample the ADC to 12 bits and produce a 14 bit `hiresValue`.
+     *
+     * @details In high resolution mode the moving average window is fixed at
+     *          `ATPOT_HIRES_READINGS` (16) samples, whatever `setNumReadings()` set, and decimated to
+     *          a 12 bit reading instead of 10 bits. Only a 16 sample sum carries 2 real extra bits, a
+     *          shorter window would give a 10 bit reading times 4. `changed()` is triggered whenever the 14 bit `hiresValue`
+     *          changes, even when the mapped `newValue` stays the same. The debounce threshold is
+     *          then counted in 12 bit steps. Changing the mode restarts change detection so the
+     *          current position is reported again.
+     */
+    void setHighResolution(bool enabled);
+
+    /**
+     * @brief Checks whether the high resolution mode is enabled.
+     *
+     * @return true if the high resolution mode is enabled.
+     */
+    bool isHighResolution() const;
+
+    /**
+     * @brief Restarts change detection, so the next scan reports the current position again.
+     *
+     * @details Used after the destination of the value changed (for example a new preset), so the
+     *          receiver learns the position without the pot having to move.
+     */
+    void refresh();
+
+    /**
+     * @brief Selects the response curve.
+     *
+     * @param curve One of `ATPOT_CURVE_LINEAR` ... `ATPOT_CURVE_REVERSE`, out of range values select linear.
+     *
+     * @details The curves are tables generated at compile time and kept in flash, shared by all
+     *          the pots, so a curve costs no RAM. The curve also applies to `hiresValue` in high
+     *          resolution mode.
+     */
+    void setCurve(byte curve);
+
+    /**
+     * @brief Gets the selected response curve.
+     *
+     * @return The selected curve (`ATPOT_CURVE_LINEAR` ... `ATPOT_CURVE_REVERSE`).
+     */
+    byte getCurve() const;
+
+    /**
+     * @brief Maps a filtered reading through the transfer function.
+     *
+     * @param reading The filtered reading (0-1023, or 0-4095 in high resolution mode).
+     * @return The position of the pot after dead zone and curve (0-16383).
+     *
+     * @details `linear()` followed by `shape()` with the selected curve: one multiply by the
+     *          precomputed reciprocal and a linear interpolation between two knots in flash, no division.
+     */
+    uint16_t transfer(int reading) const;
+
+    /**
+     * @brief Maps a filtered reading to its place on the travel, without the curve.
+     *
+     * @param reading The filtered reading (0-1023, or 0-4095 in high resolution mode).
+     * @return The position of the pot after travel and dead zone (0-16383), linear.
+     */
+    uint16_t linear(int reading) const;
+
+    /**
+     * @brief Shapes a linear position with one of the built-in curves.
+     *
+     * @param curve One of `ATPOT_CURVE_LINEAR` ... `ATPOT_CURVE_REVERSE`, out of range values select linear.
+     * @param position The linear position (0-16383), see `linearPosition`.
+     * @return The shaped position (0-16383).
+     *
+     * @details Interpolates between two knots of the curve, read from flash. Lets one pot feed
+     *          several destinations, each with its own curve, from the one set of curves in flash.
+     */
+    static uint16_t shape(byte curve, uint16_t position);
+
+    /**
+     * @brief Converts an output hysteresis to a distance in positions.
+     *
+     * @param percent How far, in percent of an output step, the position has to move past a step
+     *                boundary before the value changes (0-90).
+     * @param steps The number of output steps over the travel.
+     * @return The margin in positions (0-16383).
+     */
+    static uint16_t hysteresisMargin(byte percent, uint16_t steps);
+
+    /**
+     * @brief Checks whether the hysteresis holds an output at its current step.
+     *
+     * @param position The position of the pot (0-16383).
+     * @param margin The margin from `hysteresisMargin()`.
+     * @param last The step currently sent (0 - `steps` - 1), -1 when nothing was sent yet.
+     * @param steps The number of output steps over the travel.
+     * @return true if the position moved back by the margin in either direction is still in the
+     *         `last` step, so the output stays. Always false for a margin of 0 or no `last` step.
+     *
+     * @details Shared by `scan()` and `ATROUTER::update()`, so the pot's own output and the
+     *          router's destinations behave alike. Step n covers positions n * 16384 / steps on.
+     */
+    static bool hysteresisHolds(uint16_t position, uint16_t margin, int last, uint16_t steps);
+
+    /**
+     * @brief Scales a position to the output range.
+     *
+     * @param position The position of the pot (0-16383).
+     * @return The value between `_minVal` and `_maxVal`.
+     */
+    int scale(uint16_t position) const;
+
+    /**
+     * @brief Gets the analog pin of the potentiometer.
+     *
+     * @return The analog pin connected to the potentiometer.
+     */
+    byte getPin() const;
 
     /**
      * @brief The raw analog value read from the potentiometer (0-1023).
@@ -122,9 +595,15 @@ public:
     int rawValue;
 
     /**
-     * @brief The mapped value of the potentiometer, scaled to the range between `_minVal` and `_maxVal`.
+     * @brief The 14 bit value of the potentiometer (0-16383), only updated in high resolution mode.
+     */
+    uint16_t hiresValue = 0;
+
+    /**
+     * @brief The linear position of the last scan (0-16383), after travel and dead zone but before
+     *        the curve, updated on every scan.
      */
-    int value;
+    uint16_t linearPosition = 0;
 
     /**
      * @brief Flag indicating whether the potentiometer's value has changed since the last scan.
@@ -147,6 +626,62 @@ public:
      */
     void setChangeHandler(void (*handler)(byte, byte));
 
+    /**
+     * @brief Sets the event handler function.
+     *
+     * @param handler A pointer to the function called with an `ATEVENT` whenever the value changes, or nullptr.
+     *
+     * @details Unlike the change handler, the event carries the full 16 bit value (the 14 bit
+     *          `hiresValue` in high resolution mode), the previous one, the pot's source id and the time
+     *          the samples were taken off the ADC buffer. It is called before `changed()`.
+     */
+    void setEventHandler(void (*handler)(const ATEVENT&));
+
+    /**
+     * @brief Sets the source id carried by the pot's events.
+     *
+     * @param source The id, `ATPOTBANK` numbers its pots 0, 1, ... in `begin()`.
+     */
+    void setSource(byte source);
+
+    /**
+     * @brief Gets the source id carried by the pot's events.
+     *
+     * @return The id.
+     */
+    byte getSource() const;
+
+    /**
+     * @brief Replaces the pin with a sample generator.
+     *
+     * @param sampler A function returning one raw reading (0 - `MAX_ANALOG_POT_READING`) per scan, or
+     *                nullptr to read the pin again.
+     *
+     * @details Meant for benchmarks and tests: the generated readings go through the same filter,
+     *          transfer function and handlers as real ones.
+     */
+    void setSampler(int (*sampler)());
+
+    /**
+     * @brief Feeds every raw sample into a noise profile.
+     *
+     * @param profile The profile, or nullptr to stop profiling.
+     *
+     * @details The pot keeps working as usual, run it while the pot is at rest and then
+     *          `ATPOTNOISE::tune()` the filter from the profile.
+     */
+    void setProfile(ATPOTNOISE* profile);
+
+    /**
+     * @brief Records every raw sample into a trace.
+     *
+     * @param trace The trace, or nullptr to stop recording.
+     *
+     * @details Like the profile the trace gets the samples before the spike rejector, together with
+     *          the samples the ADC engine dropped, so the host can replay exactly what the pot read.
+     */
+    void setTrace(ATTRACE* trace);
+
 protected:
     /**
      * @brief Virtual method called when the potentiometer's value changes.
@@ -157,6 +692,11 @@ protected:
      */
     virtual void changed(byte newValue, byte oldValue);
 
+    /**
+     * @brief Sets up the pin, the output range and the dead zone, shared by the constructors.
+     */
+    void init(byte pin, int minVal, int maxVal, uint16_t deadZoneTenths);
+
     /**
      * @brief The minimum output value of the potentiometer.
      */
@@ -173,44 +713,148 @@ protected:
     int _maxVal = MAX_ANALOG_POT_READING;
 
     /**
-     * @brief The last read value of the potentiometer.
+     * @brief The dead zone percentage, in tenths of a percent (`ATPOT_DEADZONE_SCALE`).
      */
-    int _lastReading = -1; // Initialize to an invalid value
+    uint16_t _deadZoneTenths = 0;
 
     /**
-     * @brief The dead zone percentage.
+     * @brief Reading at the heel end of the travel (0-1023).
      */
-    float _deadZonePercent = 0;
+    int _travelLow = 0;
 
     /**
-     * @brief The calculated dead zone factor.
+     * @brief Reading at the toe end of the travel (0-1023).
      */
-    int _deadZoneFactor = 0;
+    int _travelHigh = MAX_ANALOG_POT_READING;
+
+    /**
+     * @brief The selected response curve.
+     */
+    byte _curve = ATPOT_CURVE_LINEAR;
+
+    /**
+     * @brief Recomputes the active reading range and its reciprocal.
+     *
+     * @details Called whenever the dead zone, the travel or the resolution changes, so `scan()`
+     *          only has to multiply the reading.
+     */
+    void buildTransfer();
+
+    /**
+     * @brief Lowest reading of the active range, readings below map to position 0.
+     */
+    int _rawLow = 0;
+
+    /**
+     * @brief Highest reading of the active range, readings above map to the last position.
+     */
+    int _rawHigh = MAX_ANALOG_POT_READING;
+
+    /**
+     * @brief Reciprocal of the active range, turns a reading into a curve segment with 8 fraction bits.
+     */
+    uint32_t _lutScale = 0;
+
     /**
      * @brief Pointer to the function that will be called when the potentiometer's value changes.
      */
     void (*_changeHandler)(byte, byte) = nullptr;
 
+    /**
+     * @brief Pointer to the function called with the event of every change.
+     */
+    void (*_eventHandler)(const ATEVENT&) = nullptr;
+
+    /**
+     * @brief The source id carried by the pot's events.
+     */
+    byte _source = 0;
+
+    /**
+     * @brief Function generating the readings in place of the pin, nullptr to read the pin.
+     */
+    int (*_sampler)() = nullptr;
+
+    /**
+     * @brief Noise profile receiving the raw samples, nullptr when not profiling.
+     */
+    ATPOTNOISE* _profile = nullptr;
+
+    /**
+     * @brief Trace recording the raw samples, nullptr when not recording.
+     */
+    ATTRACE* _trace = nullptr;
+
+    /**
+     * @brief The filter and change detection state, packed.
+     */
+    ATPOTSTATE _state;
+
 private:
     /**
      * @brief Reads the analog value from the potentiometer pin with averaging and debouncing.
      *
      * @return The averaged and debounced analog reading from the potentiometer.
      *
-     * @details Reads the analog value from the specified pin multiple times, calculates the average,
-     *          rejects outliers (highest and lowest values), and applies debouncing.
+     * @details Feeds the new samples (one from the sampler when one is set, from the background ADC
+     *          engine `ATADC` when it is running on this pin, otherwise a single `analogRead()`) into the moving average filter, through
+     *          the adaptive filter when it is enabled, and applies debouncing. Each sample costs a constant amount of work, whatever the window length.
      *          Debouncing prevents small fluctuations in the reading from being registered as changes.
      */
     int aRead();
 
+    /**
+     * @brief Adds one raw sample to the filter.
+     *
+     * @param sample The raw analog reading (0-1023).
+     *
+     * @details The sample first goes through a median-of-3 outlier rejector, which removes
+     *          single sample spikes, and then into the ring buffer. The running sum is updated
+     *          by adding the new sample and subtracting the one leaving the window.
+     */
+    void addSample(int sample);
+
+    /**
+     * @brief Gets one sample of the window.
+     *
+     * @param index The ring buffer index (0 - `ATPOT_MAX_READINGS` - 1).
+     * @return The sample (0-1023).
+     */
+    int sample(byte index) const;
+
     /**
      * @brief The number of readings to be averaged.
      */
-    int _numReadings = 10;
+    byte _numReadings = 10;
     /**
      * @brief The debounce threshold value.
      */
-    int _debounceThreshold = 5; // Default debounce threshold
+    byte _debounceThreshold = 5; // Default debounce threshold
+
+    /**
+     * @brief The output hysteresis in percent of an output step.
+     */
+    byte _hysteresis = 0;
+
+    /**
+     * @brief The output hysteresis as a distance in positions (0-16383), computed by `setHysteresis()`.
+     */
+    uint16_t _hysteresisMargin = 0;
+
+    /**
+     * @brief The adaptive filter smoothing, 0 when disabled.
+     */
+    byte _smoothing = 0;
+
+    /**
+     * @brief The adaptive filter response.
+     */
+    byte _response = 0;
+
+    /**
+     * @brief Coefficient of the adaptive filter for a still pedal (1-256, 256 is no smoothing).
+     */
+    uint16_t _alphaMin = 256;
 };
 
 /**
@@ -244,7 +888,11 @@ public:
      * @details Initializes the potentiometer with custom dead zone and default min/max values of 0 and 127.
      *          It also sets the MIDI channel and CC number.
      */
-    ATMIDICCPOT(byte pin, byte ch, byte cc, float deadZonePercent);
+    ATMIDICCPOT(byte pin, byte ch, byte cc, float deadZonePercent)
+        : ATPOT { pin, 0, 127, deadZonePercent }
+    {
+        INIT(ch, cc);
+    }
 
     /**
      * @brief Initializes the ATMIDICCPOT with a MIDI channel and CC number.
@@ -268,15 +916,28 @@ public:
      * @details This method initializes the MIDI channel, CC number, and a custom value array.
      *          When the potentiometer's value changes, the mapped index in the `values` array will be used.
      *          This allows for non-linear mapping of the potentiometer's position to MIDI values.
+     *          For the usual tapers the built-in curves (`setCurve()`) need no array.
      */
     void INIT(byte ch, byte cc, byte* values, byte count);
 
+    /**
+     * @brief Sends the messages through a non-blocking DIN MIDI writer.
+     *
+     * @param out The writer, or nullptr to write to `Serial` directly.
+     *
+     * @details Through `ATDINMIDI` a change never waits on the UART, uses running status, and a
+     *          value that can not go out yet is replaced by the next one.
+     */
+    void setOutput(ATDINMIDI* out);
+
     /**
      * @brief Overrides the `changed()` method to send MIDI CC messages.
      *
      * @details This method is called when the potentiometer's value changes.
      *          It sends a MIDI CC message with the assigned CC number and the mapped value.
      *          If a custom value array is used, the mapped index in the array is used as the value.
+     *          In high resolution mode (CC 0-31 without a value array) it sends the MSB on the assigned CC
+     *          and the LSB on CC + 32. The message goes to the `setOutput()` writer when one is set.
      */
     virtual void changed(byte newValue, byte oldValue);
 
@@ -305,5 +966,76 @@ private:
      * @brief Flag indicating whether a custom value array is used.
      */
     bool valueType = false;
+
+    /**
+     * @brief The DIN MIDI writer, nullptr to write to `Serial` directly.
+     */
+    ATDINMIDI* _out = nullptr;
+};
+
+/**
+ * @brief Scans several potentiometers on different analog pins.
+ *
+ * @details The bank hands the pins of its pots to the background sampler (`ATADC`), which
+ *          round-robins the ADC multiplexer between them. The next channel's conversion runs in
+ *          hardware while the current result is filtered and dispatched, and the first conversion
+ *          after each multiplexer switch is thrown away. Adding a pot only adds its own filtering
+ *          and dispatch to `scan()`, never a blocking read.
+ */
+class ATPOTBANK {
+public:
+    /**
+     * @brief Constructor for the ATPOTBANK class.
+     *
+     * @param pots Array of pointers to the pots of the bank.
+     * @param count The number of pots in the array (at most `ATADC_MAX_CHANNELS`).
+     *
+     * @details Pots past `ATADC_MAX_CHANNELS` are left out of the bank. Prefer the array
+     *          constructor, which stops the build instead.
+     */
+    ATPOTBANK(ATPOT** pots, byte count);
+
+    /**
+     * @brief Constructor for the ATPOTBANK class from an array of pots.
+     *
+     * @tparam N The number of pots, known at compile time (at most `ATADC_MAX_CHANNELS`).
+     * @param pots Array of pointers to the pots of the bank.
+     */
+    template <byte N>
+    ATPOTBANK(ATPOT* (&pots)[N])
+        : ATPOTBANK(pots, N)
+    {
+        static_assert(N <= ATADC_MAX_CHANNELS, "more pots in the bank than ATADC_MAX_CHANNELS, raise it (up to 12)");
+    }
+
+    /**
+     * @brief Starts background sampling of all the pots in the bank.
+     */
+    void begin();
+
+    /**
+     * @brief Scans all the pots in the bank.
+     *
+     * @details This function should be called repeatedly in the main loop.
+     */
+    void scan();
+
+    /**
+     * @brief Gets the number of pots in the bank.
+     *
+     * @return The number of pots.
+     */
+    byte count() const;
+
+private:
+    /**
+     * @brief Array of pointers to the pots of the bank.
+     */
+    ATPOT** _pots;
+
+    /**
+     * @brief The number of pots in the bank.
+     */
+    byte _count;
 };
 #endif
@@ -0,0 +1,159 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's lock-free interrupt to main loop queue and input events.
+ *****************************************************************************/
+
+#ifndef ATQUEUE_H
+#define ATQUEUE_H
+#include <Arduino.h>
+
+/**
+ * @brief Compiler barrier, keeps the item copy and the index update in program order.
+ *
+ * @details The AVR core executes in order, so stopping the compiler from moving memory accesses
+ *          across this point is all a single producer, single consumer queue needs.
+ */
+#define ATQUEUE_FENCE() __asm__ __volatile__("" ::: "memory")
+
+/**
+ * @brief One input event, from a pot scan or an interrupt.
+ */
+struct ATEVENT {
+    /** @brief Which input produced the event (the pot's bank index, or a sketch defined id). */
+    byte source;
+    /** @brief The new value. */
+    uint16_t value;
+    /** @brief The value before the event. */
+    uint16_t previous;
+    /** @brief Time the input was captured (micros). */
+    unsigned long at;
+};
+
+/**
+ * @brief Lock-free single producer, single consumer ring buffer.
+ *
+ * @tparam T The item type.
+ * @tparam Size The capacity (a power of two, 2-128).
+ *
+ * @details Made for the handoff between one interrupt handler and the main loop. The producer
+ *          only writes `_head` and the consumer only writes `_tail`, both single bytes that the AVR
+ *          reads and writes atomically, so neither side ever turns interrupts off. The indices run
+ *          freely and are masked on access, their difference is the number of items. A push into
+ *          a full queue is refused and counted, the items already queued are never overwritten.
+ */
+template <typename T, byte Size>
+class ATQUEUE {
+    static_assert(Size >= 2 && Size <= 128 && (Size & (Size - 1)) == 0, "ATQUEUE size is a power of two, 2-128");
+
+public:
+    /**
+     * @brief Adds an item, producer side (typically an interrupt handler).
+     *
+     * @param item The item to add.
+     * @return true if it was added, false if the queue was full.
+     */
+    bool push(const T& item)
+    {
+        byte head = _head;
+        if ((byte)(head - _tail) == Size) {
+            _dropped++;
+            return false;
+        }
+        _items[head & (Size - 1)] = item;
+        ATQUEUE_FENCE();
+        _head = head + 1;
+        return true;
+    }
+
+    /**
+     * @brief Takes the oldest item, consumer side (the main loop).
+     *
+     * @param item Receives the item.
+     * @return true if an item was taken, false if the queue was empty.
+     */
+    bool pop(T& item)
+    {
+        byte tail = _tail;
+        if (tail == _head) {
+            return false;
+        }
+        item = _items[tail & (Size - 1)];
+        ATQUEUE_FENCE();
+        _tail = tail + 1;
+        return true;
+    }
+
+    /**
+     * @brief Gets the oldest item without taking it, consumer side.
+     *
+     * @param item Receives the item.
+     * @return true if an item is queued, false if the queue is empty.
+     */
+    bool peek(T& item) const
+    {
+        byte tail = _tail;
+        if (tail == _head) {
+            return false;
+        }
+        item = _items[tail & (Size - 1)];
+        return true;
+    }
+
+    /**
+     * @brief Gets the newest item without taking it, consumer side.
+     *
+     * @return The item added last, also when it was already taken.
+     */
+    T newest() const
+    {
+        return _items[(byte)(_head - 1) & (Size - 1)];
+    }
+
+    /**
+     * @brief Gets the number of queued items.
+     *
+     * @return The number of items (0 - `Size`).
+     */
+    byte available() const
+    {
+        return _head - _tail;
+    }
+
+    /**
+     * @brief Gets the number of items refused because the queue was full.
+     *
+     * @return The count, read without turning interrupts off.
+     */
+    uint16_t dropped() const
+    {
+        uint16_t count;
+        do {
+            count = _dropped;
+        } while (count != _dropped); // the producer updated it between the two byte reads
+        return count;
+    }
+
+    /**
+     * @brief Empties the queue and clears the drop count.
+     *
+     * @details Only call while the producer is stopped.
+     */
+    void clear()
+    {
+        _head = 0;
+        _tail = 0;
+        _dropped = 0;
+    }
+
+private:
+    T _items[Size];
+    volatile byte _head = 0;
+    volatile byte _tail = 0;
+    volatile uint16_t _dropped = 0;
+};
+#endif
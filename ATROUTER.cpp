@@ -0,0 +1,153 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Amit's pedal output router (USB-MIDI and DIN fan-out).
+ *****************************************************************************/
+
+#include "ATROUTER.h"
+#include "ATDINMIDI.h"
+#include "ATMIDIOUT.h"
+#include "ATPOTS.h"
+
+/**
+ * @brief Constructor for the ATROUTER class.
+ *
+ * @param usb The output stage of the USB port, or nullptr when the unit has no USB output.
+ * @param din The writer of the DIN port, or nullptr when the unit has no DIN socket.
+ */
+ATROUTER::ATROUTER(ATMIDIOUT* usb, ATDINMIDI* din)
+{
+    _usb = usb;
+    _din = din;
+    for (byte i = 0; i < ATROUTER_ROUTES; i++) {
+        _routes[i] = { 0, 1, ATPOT_CURVE_LINEAR, 0 };
+        _last[i] = -1;
+    }
+}
+
+/**
+ * @brief Sets one destination.
+ *
+ * @param index The destination (0 - `ATROUTER_ROUTES` - 1).
+ * @param route The CC, channel, curve and ports, ports 0 (or CC 0) disables the destination.
+ */
+void ATROUTER::setRoute(byte index, const ATROUTE& route)
+{
+    if (index >= ATROUTER_ROUTES) {
+        return;
+    }
+    _routes[index] = route;
+    _routes[index].ch = constrain(route.ch, 1, 16);
+    _last[index] = -1;
+}
+
+/**
+ * @brief Gets one destination.
+ *
+ * @param index The destination (0 - `ATROUTER_ROUTES` - 1).
+ * @return The destination.
+ */
+const ATROUTE& ATROUTER::getRoute(byte index) const
+{
+    return _routes[index < ATROUTER_ROUTES ? index : 0];
+}
+
+/**
+ * @brief Enables or disables 14 bit output.
+ *
+ * @param enabled true to send destinations on CC 0-31 as 14 bit MSB/LSB pairs.
+ *
+ * @details Every destination is sent again in the new resolution.
+ */
+void ATROUTER::setHighResolution(bool enabled)
+{
+    if (enabled != _highResolution) {
+        _highResolution = enabled;
+        refresh();
+    }
+}
+
+/**
+ * @brief Sets the output hysteresis of the 7 bit destinations.
+ *
+ * @param percent How far, in percent of an output step, the position has to move past a step
+ *                boundary before the value changes (0-90).
+ */
+void ATROUTER::setHysteresis(byte percent)
+{
+    _hysteresisMargin = ATPOT::hysteresisMargin(percent, 128);
+}
+
+/**
+ * @brief Sends the current value of every destination again on the next `update()`.
+ */
+void ATROUTER::refresh()
+{
+    for (byte i = 0; i < ATROUTER_ROUTES; i++) {
+        _last[i] = -1;
+    }
+}
+
+/**
+ * @brief Computes the value of every destination and queues the ones that changed.
+ *
+ * @param position The linear position of the pedal (0-16383).
+ *
+ * @details Per destination one curve lookup and a compare, plus two shifts for the hysteresis
+ *          check of a 7 bit value. The hysteresis is the pot's own (`ATPOT::hysteresisHolds()`)
+ *          over 128 steps: a new value is only taken when the position is still outside the
+ *          current value's step after moving it back by the margin in either direction.
+ */
+void ATROUTER::update(uint16_t position)
+{
+    for (byte i = 0; i < ATROUTER_ROUTES; i++) {
+        const ATROUTE& route = _routes[i];
+        if (!route.ports || !route.cc) {
+            continue;
+        }
+        uint16_t shaped = ATPOT::shape(route.curve, position);
+
+        if (_highResolution && route.cc < 32) {
+            if ((int)shaped != _last[i]) {
+                _last[i] = shaped;
+                send(route, shaped, true);
+            }
+            continue;
+        }
+
+        int value = shaped >> 7; // 128 equal steps
+        if (value == _last[i]) {
+            continue;
+        }
+        if (ATPOT::hysteresisHolds(shaped, _hysteresisMargin, _last[i], 128)) {
+            continue; // not far enough into the next step yet
+        }
+        _last[i] = value;
+        send(route, value, false);
+    }
+}
+
+/**
+ * @brief Hands one value to the queues of a destination's ports.
+ */
+void ATROUTER::send(const ATROUTE& route, uint16_t value, bool hires)
+{
+    if ((route.ports & ATROUTE_USB) && _usb != nullptr) {
+        if (hires) {
+            _usb->send14(route.cc, value, route.ch);
+        } else {
+            _usb->send(route.cc, value, route.ch);
+        }
+    }
+    if ((route.ports & ATROUTE_DIN) && _din != nullptr) {
+        if (hires) {
+            _din->controlChange14(route.cc, value, route.ch);
+        } else {
+            _din->controlChange(route.cc, value, route.ch);
+        }
+    }
+}
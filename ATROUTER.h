@@ -0,0 +1,137 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's pedal output router (USB-MIDI and DIN fan-out).
+ *****************************************************************************/
+
+#ifndef ATROUTER_H
+#define ATROUTER_H
+#include <Arduino.h>
+
+class ATMIDIOUT;
+class ATDINMIDI;
+
+/**
+ * @brief Maximum number of destinations one pedal can drive.
+ */
+#define ATROUTER_ROUTES 4
+
+/**
+ * @brief Port bit: the destination is sent over USB-MIDI.
+ */
+#define ATROUTE_USB 0x01
+
+/**
+ * @brief Port bit: the destination is sent over 5-pin DIN MIDI.
+ */
+#define ATROUTE_DIN 0x02
+
+/**
+ * @brief One destination of a pedal.
+ */
+struct ATROUTE {
+    /** @brief MIDI CC number. */
+    byte cc;
+    /** @brief MIDI channel (1-16). */
+    byte ch;
+    /** @brief Response curve (`ATPOT_CURVE_LINEAR` ... `ATPOT_CURVE_REVERSE`). */
+    byte curve;
+    /** @brief Ports the destination is sent to (`ATROUTE_USB`, `ATROUTE_DIN`), 0 when unused. */
+    byte ports;
+};
+
+/**
+ * @brief Fans one pedal out to several CC destinations on USB-MIDI, DIN MIDI or both.
+ *
+ * @details Takes the linear position of the pedal (`ATPOT::linearPosition`) once per scan and
+ *          computes the value of every destination from it in the same pass, each through its
+ *          own curve (`ATPOT::shape()`, tables kept in flash) with its own change detection and
+ *          hysteresis. A changed value is handed to the queue of each of its ports: the rate
+ *          limited `ATMIDIOUT` in front of USB, and the coalescing `ATDINMIDI` for DIN. The
+ *          ports never wait on each other, a backed up DIN port only coalesces its own values.
+ */
+class ATROUTER {
+
+public:
+    /**
+     * @brief Constructor for the ATROUTER class.
+     *
+     * @param usb The output stage of the USB port, or nullptr when the unit has no USB output.
+     * @param din The writer of the DIN port, or nullptr when the unit has no DIN socket.
+     */
+    ATROUTER(ATMIDIOUT* usb, ATDINMIDI* din);
+
+    /**
+     * @brief Sets one destination.
+     *
+     * @param index The destination (0 - `ATROUTER_ROUTES` - 1).
+     * @param route The CC, channel, curve and ports, ports 0 (or CC 0) disables the destination.
+     *
+     * @details The destination's current value is sent again on the next `update()`.
+     */
+    void setRoute(byte index, const ATROUTE& route);
+
+    /**
+     * @brief Gets one destination.
+     *
+     * @param index The destination (0 - `ATROUTER_ROUTES` - 1).
+     * @return The destination.
+     */
+    const ATROUTE& getRoute(byte index) const;
+
+    /**
+     * @brief Enables or disables 14 bit output.
+     *
+     * @param enabled true to send destinations on CC 0-31 as 14 bit MSB/LSB pairs.
+     */
+    void setHighResolution(bool enabled);
+
+    /**
+     * @brief Sets the output hysteresis of the 7 bit destinations.
+     *
+     * @param percent How far, in percent of an output step, the position has to move past a step
+     *                boundary before the value changes (0-90), as `ATPOT::setHysteresis()`.
+     */
+    void setHysteresis(byte percent);
+
+    /**
+     * @brief Sends the current value of every destination again on the next `update()`.
+     */
+    void refresh();
+
+    /**
+     * @brief Computes the value of every destination and queues the ones that changed.
+     *
+     * @param position The linear position of the pedal (0-16383).
+     *
+     * @details Call this once per scan, after the pedal was scanned.
+     */
+    void update(uint16_t position);
+
+private:
+    /**
+     * @brief Hands one value to the queues of a destination's ports.
+     */
+    void send(const ATROUTE& route, uint16_t value, bool hires);
+
+    ATROUTE _routes[ATROUTER_ROUTES];
+
+    /**
+     * @brief Last value sent per destination (7 or 14 bit), -1 to send the next one whatever it is.
+     */
+    int _last[ATROUTER_ROUTES];
+
+    ATMIDIOUT* _usb;
+    ATDINMIDI* _din;
+    bool _highResolution = false;
+
+    /**
+     * @brief The output hysteresis as a distance in positions (0-16383).
+     */
+    uint16_t _hysteresisMargin = 0;
+};
+#endif
@@ -0,0 +1,163 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Amit's timer driven cooperative task scheduler (ATmega32u4).
+ *****************************************************************************/
+
+#include "ATSCHED.h"
+#include <util/atomic.h>
+
+volatile uint16_t ATSCHED::_ticks = 0;
+volatile byte ATSCHED::_stride = 1;
+
+/**
+ * @brief Starts the tick timer.
+ *
+ * @param tickHz The tick rate (16 - 250000 ticks per second).
+ *
+ * @details Timer3 runs in CTC mode from the system clock divided by 64 (250 kHz at 16 MHz),
+ *          with the compare A interrupt enabled.
+ */
+void ATSCHED::begin(unsigned long tickHz)
+{
+    tickHz = constrain(tickHz, 16, F_CPU / 64);
+    _tickCounts = F_CPU / 64 / tickHz;
+    noInterrupts();
+#ifdef __AVR__
+    TCCR3A = 0;
+    TCCR3B = (1 << WGM32) | (1 << CS31) | (1 << CS30); // CTC, clk / 64
+    OCR3A = _tickCounts - 1;
+    TCNT3 = 0;
+    TIMSK3 = (1 << OCIE3A);
+#endif
+    _ticks = 0;
+    _stride = 1;
+    for (byte i = 0; i < _count; i++) {
+        _tasks[i].due = 0;
+    }
+    interrupts();
+}
+
+/**
+ * @brief Sets how many ticks one timer interrupt counts.
+ *
+ * @param stride Ticks per interrupt (1-255), limited so the compare value fits Timer3.
+ *
+ * @details Moves the whole ticks the counter has already passed into the tick count, leaving
+ *          only the part of a tick, so the counter is always below the new compare value and
+ *          no tick is lost or counted twice.
+ */
+void ATSCHED::setStride(byte stride)
+{
+    stride = constrain(stride, 1, 65536UL / _tickCounts);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+#ifdef __AVR__
+        uint16_t whole = TCNT3 / _tickCounts;
+        _ticks += whole;
+        TCNT3 -= whole * _tickCounts;
+        OCR3A = (uint16_t)(_tickCounts * stride - 1);
+#endif
+        _stride = stride;
+    }
+}
+
+/**
+ * @brief Adds a task.
+ *
+ * @param task The function to run.
+ * @param period Ticks between two runs, 0 to run on every pass.
+ * @param budgetUS Longest expected run time in microseconds, longer runs count as overruns.
+ * @param stat Statistics that receive the run times and overruns, or nullptr.
+ * @return true if the task was added, false when `ATSCHED_MAX_TASKS` tasks are already scheduled.
+ */
+bool ATSCHED::add(void (*task)(), uint16_t period, uint16_t budgetUS, ATSTAT* stat)
+{
+    if (_count == ATSCHED_MAX_TASKS) {
+        return false;
+    }
+    _tasks[_count] = { task, period, budgetUS, ticks(), stat };
+    _count++;
+    return true;
+}
+
+/**
+ * @brief Runs the tasks that are due.
+ *
+ * @details A periodic task is due once the tick count reaches its `due` tick. The next run is
+ *          scheduled one period after the tick it was due at, so the rate does not drift with the
+ *          start delay. A task that is a whole period or more late skips the missed runs and
+ *          counts an overrun. With a stride the ticks arrive in steps, so a task is only late once
+ *          it is behind by more than the stride allows, and the runs a step passed over are skipped.
+ */
+void ATSCHED::run()
+{
+    for (byte i = 0; i < _count; i++) {
+        Task& task = _tasks[i];
+        bool late = false;
+        if (task.period) {
+            uint16_t now = ticks();
+            uint16_t behind = now - task.due;
+            if ((int16_t)behind < 0) {
+                continue; // not due yet
+            }
+            if (behind >= task.period + _stride - 1) {
+                late = true;
+                task.due = now + task.period;
+            } else {
+                task.due += (behind / task.period + 1) * task.period; // the next due tick after now
+            }
+        }
+
+        unsigned long start = micros();
+        task.run();
+        unsigned long took = micros() - start;
+
+        if (task.stat) {
+            task.stat->record(took);
+            if (late || took > task.budget) {
+                task.stat->overruns++;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Gets the number of ticks since `begin()`.
+ *
+ * @return The tick count, wraps around.
+ *
+ * @details Restores the interrupt state it found, so it can be called from an interrupt handler
+ *          or inside another atomic section.
+ */
+uint16_t ATSCHED::ticks()
+{
+    uint16_t ticks;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ticks = _ticks;
+    }
+    return ticks;
+}
+
+/**
+ * @brief Counts one tick, or the stride's ticks.
+ */
+void ATSCHED::tick()
+{
+    _ticks += _stride;
+}
+
+#ifdef __AVR__
+/**
+ * @brief Timer3 compare A interrupt, the scheduler tick.
+ */
+ISR(TIMER3_COMPA_vect)
+{
+    ATSCHED::tick();
+}
+#endif
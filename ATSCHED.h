@@ -0,0 +1,120 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's timer driven cooperative task scheduler (ATmega32u4).
+ *****************************************************************************/
+
+#ifndef ATSCHED_H
+#define ATSCHED_H
+#include "ATSTATS.h"
+#include <Arduino.h>
+
+/**
+ * @brief Maximum number of tasks the scheduler can run.
+ */
+#define ATSCHED_MAX_TASKS 6
+
+/**
+ * @brief Cooperative scheduler running tasks at fixed rates from a Timer3 tick.
+ *
+ * @details Timer3 (unused by the Arduino core on the 32u4) interrupts at the tick rate and
+ *          only counts ticks. `run()`, called from `loop()`, runs every task whose next tick has
+ *          come, in the order they were added, so a periodic task runs at a fixed rate no matter
+ *          how long the other tasks take. Tasks with a period of 0 run on every pass, for work
+ *          that has to happen as soon as possible. Every run is timed into the task's `ATSTAT`.
+ *          A run counts as an overrun when it took longer than the task's budget, or when the
+ *          task started a whole period late (the missed ticks are skipped, not caught up).
+ *          `setStride()` lets one timer interrupt count several ticks, so an idle sketch is woken
+ *          less often while the tick count and the task periods keep their meaning.
+ */
+class ATSCHED {
+
+public:
+    /**
+     * @brief Starts the tick timer.
+     *
+     * @param tickHz The tick rate (16 - 250000 ticks per second).
+     */
+    void begin(unsigned long tickHz);
+
+    /**
+     * @brief Sets how many ticks one timer interrupt counts.
+     *
+     * @param stride Ticks per interrupt (1-255), 1 for one interrupt per tick.
+     *
+     * @details The interrupt rate drops by the stride, and so does the timing resolution of the
+     *          periodic tasks: a task runs on the first interrupt at or after its due tick. The ticks
+     *          that passed since the last interrupt are counted at once.
+     */
+    void setStride(byte stride);
+
+    /**
+     * @brief Adds a task.
+     *
+     * @param task The function to run.
+     * @param period Ticks between two runs, 0 to run on every pass.
+     * @param budgetUS Longest expected run time in microseconds, longer runs count as overruns.
+     * @param stat Statistics that receive the run times and overruns, or nullptr.
+     * @return true if the task was added, false when `ATSCHED_MAX_TASKS` tasks are already scheduled.
+     */
+    bool add(void (*task)(), uint16_t period, uint16_t budgetUS, ATSTAT* stat);
+
+    /**
+     * @brief Runs the tasks that are due.
+     *
+     * @details Call this on every pass of the main loop.
+     */
+    void run();
+
+    /**
+     * @brief Gets the number of ticks since `begin()`.
+     *
+     * @return The tick count, wraps around.
+     */
+    static uint16_t ticks();
+
+    /**
+     * @brief Counts one tick, or the ticks of one stride (`setStride()`).
+     *
+     * @details Called from the Timer3 compare interrupt. Not meant to be called from sketch code,
+     *          host builds call it to advance a simulated timer.
+     */
+    static void tick();
+
+private:
+    /**
+     * @brief One scheduled task.
+     */
+    struct Task {
+        /** @brief The function to run. */
+        void (*run)();
+        /** @brief Ticks between two runs, 0 for every pass. */
+        uint16_t period;
+        /** @brief Longest expected run time in microseconds. */
+        uint16_t budget;
+        /** @brief Tick the next run is due at. */
+        uint16_t due;
+        /** @brief Statistics of the task, or nullptr. */
+        ATSTAT* stat;
+    };
+
+    Task _tasks[ATSCHED_MAX_TASKS];
+    byte _count = 0;
+
+    /**
+     * @brief Timer3 counts per tick.
+     */
+    uint16_t _tickCounts = 1;
+
+    static volatile uint16_t _ticks;
+
+    /**
+     * @brief Ticks counted per interrupt.
+     */
+    static volatile byte _stride;
+};
+#endif
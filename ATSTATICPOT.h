@@ -0,0 +1,150 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's compile time configured Potentiometer class.
+ *****************************************************************************/
+
+#ifndef ATSTATICPOT_H
+#define ATSTATICPOT_H
+#include "ATADC.h"
+#include "ATPOTS.h"
+#include <Arduino.h>
+
+/**
+ * @brief Potentiometer with its whole configuration fixed at compile time.
+ *
+ * @tparam Pin The analog pin connected to the potentiometer.
+ * @tparam Min The output value at the heel (0 or more, below `Max`).
+ * @tparam Max The output value at the toe.
+ * @tparam NumReadings Length of the moving average window (1-32), a power of two turns the average into a shift.
+ * @tparam DeadZonePercent The dead zone at each end, in percent of the travel (0-49).
+ * @tparam Threshold The debounce threshold in ADC steps.
+ * @tparam Handler Function called with the new and old value when the value changes, or nullptr.
+ *                 Both are ints, so the whole range of `Max` arrives, and the old value is -1 on
+ *                 the first call.
+ *
+ * @details For fixed hardware builds that do not need the runtime setters of `ATPOT`. The
+ *          same filter as `ATPOT` (median-of-3 spike rejection, moving average, debounce
+ *          threshold) with the range, dead zone and window folded into constants: the scaling
+ *          is one multiply by a constant reciprocal and a shift, there is no virtual `changed()`
+ *          and the handler is called directly, so the compiler can inline it. On the 32u4 a pot
+ *          takes `2 * NumReadings + 12` bytes of RAM and has no vtable.
+ *          Samples come from `ATADC` when it runs on `Pin`, otherwise from `analogRead()`.
+ *          Example: `ATSTATICPOT<A0, 0, 127, 8, 10, 3, expressionChanged> POT;`
+ */
+template <byte Pin, int Min, int Max, byte NumReadings = 8, byte DeadZonePercent = 0, byte Threshold = 3,
+    void (*Handler)(int, int) = nullptr>
+class ATSTATICPOT {
+    static_assert(Min >= 0, "ATSTATICPOT values are 0 or more, -1 stands for no value yet");
+    static_assert(Min < Max, "ATSTATICPOT needs Min below Max");
+    static_assert(NumReadings >= 1 && NumReadings <= 32, "ATSTATICPOT window is 1-32 readings");
+    static_assert(DeadZonePercent < 50, "ATSTATICPOT dead zone is below 50 percent");
+
+public:
+    /**
+     * @brief Gets the analog pin of the potentiometer.
+     *
+     * @return The analog pin connected to the potentiometer.
+     */
+    static constexpr byte getPin() { return Pin; }
+
+    /**
+     * @brief Scans the potentiometer and calls the handler when the value changed.
+     *
+     * @details Call this repeatedly in the main loop.
+     */
+    void scan()
+    {
+        int8_t slot = ATADC::slot(Pin);
+        if (slot >= 0) {
+            while (ATADC::available(slot)) {
+                addSample(ATADC::read(slot));
+            }
+        } else {
+            addSample(analogRead(Pin));
+        }
+        if (!_count) {
+            return;
+        }
+
+        // a full window divides by a constant, a shift for a power of two
+        int average = _count == NumReadings ? (unsigned)_sum / NumReadings : (unsigned)_sum / _count;
+        if (abs(average - _lastAverage) < Threshold && value >= 0) {
+            return;
+        }
+        _lastAverage = average;
+
+        int newValue = scale(average);
+        if (newValue != value) {
+            int oldValue = value;
+            value = newValue;
+            if (Handler != nullptr) {
+                Handler(newValue, oldValue);
+            }
+        }
+    }
+
+    /**
+     * @brief The current value between `Min` and `Max`, -1 before the first scan.
+     */
+    int value = -1;
+
+private:
+    /** @brief Lowest reading of the active range. */
+    static constexpr int RAW_LOW = (long)MAX_ANALOG_POT_READING * DeadZonePercent / 100;
+    /** @brief Highest reading of the active range. */
+    static constexpr int RAW_HIGH = MAX_ANALOG_POT_READING - RAW_LOW;
+    /** @brief Output steps per reading, 16 fraction bits. */
+    static constexpr uint32_t SCALE = ((uint32_t)(Max - Min + 1) << 16) / (RAW_HIGH - RAW_LOW + 1);
+
+    /**
+     * @brief Scales a filtered reading to the output range.
+     */
+    static int scale(int reading)
+    {
+        if (reading <= RAW_LOW) {
+            return Min;
+        }
+        if (reading >= RAW_HIGH) {
+            return Max;
+        }
+        return Min + (int)(((uint32_t)(reading - RAW_LOW) * SCALE) >> 16);
+    }
+
+    /**
+     * @brief Adds one raw sample to the median-of-3 rejector and the moving average.
+     */
+    void addSample(int sample)
+    {
+        if (!_count) {
+            _history[0] = sample;
+            _history[1] = sample;
+        }
+        int lo = min(_history[0], _history[1]);
+        int hi = max(_history[0], _history[1]);
+        int filtered = max(lo, min(hi, sample));
+        _history[1] = _history[0];
+        _history[0] = sample;
+
+        if (_count == NumReadings) {
+            _sum -= _samples[_head];
+        } else {
+            _count++;
+        }
+        _samples[_head] = filtered;
+        _sum += filtered;
+        _head = (_head + 1) % NumReadings;
+    }
+
+    int _samples[NumReadings];
+    int _history[2];
+    int _sum = 0;
+    int _lastAverage = 0;
+    byte _head = 0;
+    byte _count = 0;
+};
+#endif
@@ -0,0 +1,108 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Amit's lightweight timing statistics.
+ *****************************************************************************/
+
+#include "ATSTATS.h"
+
+/**
+ * @brief Constructor for the ATSTAT class, starts with empty statistics.
+ */
+ATSTAT::ATSTAT()
+{
+    reset();
+}
+
+/**
+ * @brief Adds one measured duration.
+ *
+ * @param us The duration in microseconds.
+ *
+ * @details The histogram bucket is found by shifting instead of dividing:
+ *          bucket 0 is below 16 us and each next bucket doubles the limit.
+ */
+void ATSTAT::record(unsigned long us)
+{
+    uint16_t value = us > 0xFFFF ? 0xFFFF : us;
+    if (value < minimum) {
+        minimum = value;
+    }
+    if (value > maximum) {
+        maximum = value;
+    }
+    if (total > 0xFFFF0000UL) { // keep the mean meaningful on long runs
+        total >>= 1;
+        count >>= 1;
+    }
+    count++;
+    total += value;
+
+    byte bucket = 0;
+    value >>= 4;
+    while (value && bucket < ATSTAT_BUCKETS - 1) {
+        value >>= 1;
+        bucket++;
+    }
+    if (histogram[bucket] != 0xFFFF) {
+        histogram[bucket]++;
+    }
+}
+
+/**
+ * @brief Clears all statistics.
+ */
+void ATSTAT::reset()
+{
+    minimum = 0xFFFF;
+    maximum = 0;
+    count = 0;
+    total = 0;
+    overruns = 0;
+    for (byte i = 0; i < ATSTAT_BUCKETS; i++) {
+        histogram[i] = 0;
+    }
+}
+
+/**
+ * @brief Gets the mean of the recorded durations.
+ *
+ * @return The mean duration in microseconds, 0 when nothing was recorded.
+ */
+uint16_t ATSTAT::mean() const
+{
+    return count ? total / count : 0;
+}
+
+/**
+ * @brief Gets a percentile of the recorded durations from the histogram.
+ *
+ * @param percent The percentile (1-100).
+ * @return The upper limit of the bucket holding the percentile in microseconds, `maximum` for the last bucket.
+ *
+ * @details Works on the bucket counts rather than `count`, which is halved on long runs.
+ */
+uint16_t ATSTAT::percentile(byte percent) const
+{
+    unsigned long recorded = 0;
+    for (byte i = 0; i < ATSTAT_BUCKETS; i++) {
+        recorded += histogram[i];
+    }
+    if (!recorded) {
+        return 0;
+    }
+
+    unsigned long wanted = (recorded * min(percent, 100) + 99) / 100;
+    unsigned long seen = 0;
+    for (byte i = 0; i < ATSTAT_BUCKETS - 1; i++) {
+        seen += histogram[i];
+        if (seen >= wanted) {
+            return min((uint16_t)(16U << i), maximum);
+        }
+    }
+    return maximum;
+}
@@ -0,0 +1,97 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's lightweight timing statistics.
+ *****************************************************************************/
+
+#ifndef ATSTATS_H
+#define ATSTATS_H
+#include <Arduino.h>
+
+/**
+ * @brief Number of histogram buckets kept per statistic.
+ *
+ * @details Bucket 0 counts durations below 16 us, every following bucket doubles the limit
+ *          (32, 64 ... 1024 us) and the last bucket counts everything from 1024 us up.
+ */
+#define ATSTAT_BUCKETS 8
+
+/**
+ * @brief Timing statistic for one code path (min/max/mean and a log2 histogram).
+ *
+ * @details Recording a duration costs a few comparisons and shifts, no division,
+ *          so it can be used around every stage of the main loop. All values are in
+ *          microseconds as measured with `micros()` (4 us resolution at 16 MHz).
+ *          The histogram counters saturate instead of wrapping.
+ */
+class ATSTAT {
+
+public:
+    /**
+     * @brief Constructor for the ATSTAT class, starts with empty statistics.
+     */
+    ATSTAT();
+
+    /**
+     * @brief Adds one measured duration.
+     *
+     * @param us The duration in microseconds.
+     */
+    void record(unsigned long us);
+
+    /**
+     * @brief Clears all statistics.
+     */
+    void reset();
+
+    /**
+     * @brief Gets the mean of the recorded durations.
+     *
+     * @return The mean duration in microseconds, 0 when nothing was recorded.
+     */
+    uint16_t mean() const;
+
+    /**
+     * @brief Gets a percentile of the recorded durations from the histogram.
+     *
+     * @param percent The percentile (1-100).
+     * @return The upper limit of the bucket holding the percentile in microseconds (16, 32 ... 1024),
+     *         `maximum` for the last bucket, 0 when nothing was recorded.
+     */
+    uint16_t percentile(byte percent) const;
+
+    /**
+     * @brief Shortest recorded duration in microseconds (0xFFFF when nothing was recorded).
+     */
+    uint16_t minimum;
+
+    /**
+     * @brief Longest recorded duration in microseconds (saturates at 0xFFFF).
+     */
+    uint16_t maximum;
+
+    /**
+     * @brief Number of recorded durations (halved together with `total` before `total` would overflow).
+     */
+    unsigned long count;
+
+    /**
+     * @brief Sum of all recorded durations in microseconds.
+     */
+    unsigned long total;
+
+    /**
+     * @brief Log2 histogram of the recorded durations, see `ATSTAT_BUCKETS`.
+     */
+    uint16_t histogram[ATSTAT_BUCKETS];
+
+    /**
+     * @brief Number of times the code path missed its deadline or exceeded its budget, counted by `ATSCHED`.
+     */
+    unsigned long overruns;
+};
+#endif
@@ -0,0 +1,276 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Amit's wear levelled EEPROM record store.
+ *****************************************************************************/
+
+#include "ATSTORE.h"
+#include <EEPROM.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+/** @brief Save phase: nothing queued. */
+#define PHASE_IDLE 0
+/** @brief Save phase: comparing the record with the newest slot. */
+#define PHASE_COMPARE 1
+/** @brief Save phase: writing the record into the next slot. */
+#define PHASE_RECORD 2
+/** @brief Save phase: writing the version, the CRC and, last, the sequence number. */
+#define PHASE_HEADER 3
+
+/** @brief Header bytes in the order they are written, the sequence number last. */
+static const byte HEADER_ORDER[ATSTORE_HEADER_SIZE] = { 2, 3, 4, 0, 1 };
+
+/**
+ * @brief Constructor for the ATSTORE class.
+ *
+ * @param version The layout version of the record (0-254).
+ * @param size The size of the record in bytes.
+ *
+ * @details Does not touch the EEPROM, the slots are scanned on the first `load()`, `save()` or `update()`.
+ */
+ATSTORE::ATSTORE(byte version, uint16_t size)
+{
+    _version = version;
+    _size = size;
+    _slots = min(EEPROM.length() / (size + ATSTORE_HEADER_SIZE), 255);
+}
+
+/**
+ * @brief Loads the newest valid record.
+ *
+ * @param record Buffer of `size` bytes that receives the record.
+ * @return true if a valid record was found, false when the store is empty (the buffer is untouched).
+ */
+bool ATSTORE::load(void* record)
+{
+    while (update()) {
+        // finish a queued save first
+    }
+    if (!_scanned) {
+        scan();
+    }
+    if (_newest < 0) {
+        return false;
+    }
+    int data = address(_newest) + ATSTORE_HEADER_SIZE;
+    for (uint16_t i = 0; i < _size; i++) {
+        ((byte*)record)[i] = EEPROM.read(data + i);
+    }
+    return true;
+}
+
+/**
+ * @brief Saves a record in the next slot.
+ *
+ * @param record The record (`size` bytes).
+ * @return true if the record was written, false when it equals the newest saved record.
+ *
+ * @details Finishes a queued save first, then queues the record and runs `update()` until it is
+ *          written. Blocks for 3.3 ms per changed byte.
+ */
+bool ATSTORE::save(const void* record)
+{
+    while (update()) {
+        // finish a queued save first
+    }
+    int newest = _newest;
+    uint16_t sequence = _sequence;
+    queue(record);
+    while (update()) {
+        // wait for the EEPROM
+    }
+    return _newest != newest || _sequence != sequence;
+}
+
+/**
+ * @brief Starts saving a record, `update()` writes it step by step.
+ *
+ * @param record The record (`size` bytes), it must stay valid until `update()` returns false.
+ *
+ * @details Queueing again while a save runs restarts it. The slot being written only becomes the
+ *          newest with its sequence number, the last byte written, so writing it again from the
+ *          start is safe.
+ */
+void ATSTORE::queue(const void* record)
+{
+    _record = (const byte*)record;
+    _phase = PHASE_COMPARE;
+    _step = 0;
+}
+
+/**
+ * @brief Runs one step of the queued save.
+ *
+ * @return true while the save is still running, false when nothing is left to do.
+ *
+ * @details Compares the record with the newest slot first, a record equal to it writes nothing.
+ *          Then writes the record into the next slot and the version, the CRC and the sequence
+ *          number after it. Every byte is read before it is written and only a byte that differs
+ *          is written, the CRC covers the bytes as they were written.
+ */
+bool ATSTORE::update()
+{
+    if (_phase == PHASE_IDLE) {
+        return false;
+    }
+    if (!eeprom_is_ready()) {
+        return true; // the last byte write is still running
+    }
+    if (!_scanned) {
+        scan();
+    }
+
+    byte count = 0;
+    if (_phase == PHASE_COMPARE) {
+        if (_newest >= 0) {
+            int data = address(_newest) + ATSTORE_HEADER_SIZE;
+            while (_step < _size && EEPROM.read(data + _step) == _record[_step]) {
+                _step++;
+                if (++count == ATSTORE_STEP_BYTES && _step < _size) {
+                    return true;
+                }
+            }
+            if (_step == _size) {
+                _phase = PHASE_IDLE;
+                return false; // nothing changed
+            }
+        }
+        uint16_t sequence = _sequence + 1;
+        _slot = _newest < 0 ? 0 : (_newest + 1) % _slots;
+        _crc = 0xFFFF;
+        _crc = _crc16_update(_crc, sequence & 0xFF);
+        _crc = _crc16_update(_crc, sequence >> 8);
+        _crc = _crc16_update(_crc, _version);
+        _phase = PHASE_RECORD;
+        _step = 0;
+        return true;
+    }
+
+    int base = address(_slot);
+    if (_phase == PHASE_RECORD) {
+        while (_step < _size && count++ < ATSTORE_STEP_BYTES) {
+            int at = base + ATSTORE_HEADER_SIZE + _step;
+            byte value = _record[_step++];
+            _crc = _crc16_update(_crc, value);
+            if (EEPROM.read(at) != value) {
+                EEPROM.write(at, value);
+                return true;
+            }
+        }
+        if (_step == _size) {
+            _phase = PHASE_HEADER;
+            _step = 0;
+        }
+        return true;
+    }
+
+    uint16_t sequence = _sequence + 1;
+    while (_step < ATSTORE_HEADER_SIZE) {
+        byte offset = HEADER_ORDER[_step++];
+        byte value = offset == 2 ? _version
+            : offset == 3       ? _crc & 0xFF
+            : offset == 4       ? _crc >> 8
+            : offset == 0       ? sequence & 0xFF
+                                : sequence >> 8;
+        if (EEPROM.read(base + offset) != value) {
+            EEPROM.write(base + offset, value);
+            if (_step < ATSTORE_HEADER_SIZE) {
+                return true;
+            }
+            break;
+        }
+    }
+    _newest = _slot;
+    _sequence = sequence;
+    _phase = PHASE_IDLE;
+    return false;
+}
+
+/**
+ * @brief Checks whether a queued save is still running.
+ *
+ * @return true until `update()` has written the sequence number of the new slot.
+ */
+bool ATSTORE::isBusy() const
+{
+    return _phase != PHASE_IDLE;
+}
+
+/**
+ * @brief Gets the sequence number of the newest record.
+ *
+ * @return The sequence number, counting the saves since the store was first used.
+ */
+uint16_t ATSTORE::getSequence() const
+{
+    return _sequence;
+}
+
+/**
+ * @brief Gets the number of slots the records rotate through.
+ *
+ * @return The number of slots that fit in the EEPROM.
+ */
+byte ATSTORE::slotCount() const
+{
+    return _slots;
+}
+
+/**
+ * @brief Finds the newest valid slot, sets `_newest` (-1 when none) and `_sequence`.
+ *
+ * @details One pass over the slot headers. Sequence numbers are compared with wrap around,
+ *          and a slot's CRC is only checked when its header makes it newer than the best slot
+ *          found so far, so a normal boot checks very few CRCs.
+ */
+void ATSTORE::scan()
+{
+    _scanned = true;
+    _newest = -1;
+    _sequence = 0;
+    for (byte slot = 0; slot < _slots; slot++) {
+        int base = address(slot);
+        if (EEPROM.read(base + 2) != _version) {
+            continue; // erased, or another layout
+        }
+        uint16_t sequence = EEPROM.read(base) | (EEPROM.read(base + 1) << 8);
+        if (_newest >= 0 && (int16_t)(sequence - _sequence) <= 0) {
+            continue;
+        }
+        uint16_t crc = EEPROM.read(base + 3) | (EEPROM.read(base + 4) << 8);
+        if (crc != storedCrc(slot)) {
+            continue;
+        }
+        _newest = slot;
+        _sequence = sequence;
+    }
+}
+
+/**
+ * @brief Gets the EEPROM address of a slot.
+ */
+int ATSTORE::address(byte slot) const
+{
+    return slot * (_size + ATSTORE_HEADER_SIZE);
+}
+
+/**
+ * @brief Computes the CRC of a slot as stored in EEPROM (sequence, version and record).
+ */
+uint16_t ATSTORE::storedCrc(byte slot) const
+{
+    int base = address(slot);
+    uint16_t crc = 0xFFFF;
+    crc = _crc16_update(crc, EEPROM.read(base));
+    crc = _crc16_update(crc, EEPROM.read(base + 1));
+    crc = _crc16_update(crc, EEPROM.read(base + 2));
+    for (uint16_t i = 0; i < _size; i++) {
+        crc = _crc16_update(crc, EEPROM.read(base + ATSTORE_HEADER_SIZE + i));
+    }
+    return crc;
+}
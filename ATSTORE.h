@@ -0,0 +1,183 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's wear levelled EEPROM record store.
+ *****************************************************************************/
+
+#ifndef ATSTORE_H
+#define ATSTORE_H
+#include <Arduino.h>
+
+/**
+ * @brief Bytes every slot adds to the record: sequence number (2), layout version (1) and CRC (2).
+ */
+#define ATSTORE_HEADER_SIZE 5
+
+/**
+ * @brief Most EEPROM bytes one `update()` reads, it starts at most one byte write besides.
+ */
+#define ATSTORE_STEP_BYTES 16
+
+/**
+ * @brief Log structured store keeping one fixed size record in round-robin EEPROM slots.
+ *
+ * @details The EEPROM is split into as many slots as fit. Every save goes to the slot after the
+ *          newest one, with the next sequence number, so the cells wear evenly instead of the same
+ *          bytes being rewritten on every save. A slot holds the sequence number, the layout version,
+ *          the record and a CRC-16 over all of it. Loading picks the valid slot with the newest
+ *          sequence number, the CRC is only computed for slots newer than the best one found so far.
+ *          The sequence number is written last, so a save interrupted by a power loss leaves the
+ *          previous record in place. Only bytes that do not already hold the value are written, and
+ *          saving a record equal to the newest one writes nothing.
+ *          A byte write takes 3.3 ms, so a whole slot takes up to half a second. `queue()` and
+ *          `update()` spread a save over many calls instead, each one reads a few bytes and starts
+ *          at most one write, and never waits for the EEPROM. `save()` does the same in one
+ *          blocking call. No heap is used.
+ */
+class ATSTORE {
+
+public:
+    /**
+     * @brief Constructor for the ATSTORE class.
+     *
+     * @param version The layout version of the record (0-254). Slots written with another
+     *                version are ignored, bump it whenever the record layout changes.
+     * @param size The size of the record in bytes.
+     */
+    ATSTORE(byte version, uint16_t size);
+
+    /**
+     * @brief Loads the newest valid record.
+     *
+     * @param record Buffer of `size` bytes that receives the record.
+     * @return true if a valid record was found, false when the store is empty (the buffer is untouched).
+     */
+    bool load(void* record);
+
+    /**
+     * @brief Saves a record in the next slot.
+     *
+     * @param record The record (`size` bytes).
+     * @return true if the record was written, false when it equals the newest saved record.
+     */
+    bool save(const void* record);
+
+    /**
+     * @brief Starts saving a record, `update()` writes it step by step.
+     *
+     * @param record The record (`size` bytes). It is read while the save runs, so it must stay
+     *               valid until `update()` returns false.
+     *
+     * @details Queueing again while a save runs restarts it with the record as it is now, call it
+     *          after every change of the record.
+     */
+    void queue(const void* record);
+
+    /**
+     * @brief Runs one step of the queued save.
+     *
+     * @return true while the save is still running, false when nothing is left to do.
+     *
+     * @details Returns at once while the EEPROM is still busy with the previous byte, otherwise reads
+     *          up to `ATSTORE_STEP_BYTES` bytes and starts at most one byte write. Meant to be
+     *          called from a low priority task, often enough to keep the EEPROM busy.
+     */
+    bool update();
+
+    /**
+     * @brief Checks whether a queued save is still running.
+     *
+     * @return true until `update()` has written the sequence number of the new slot.
+     */
+    bool isBusy() const;
+
+    /**
+     * @brief Gets the sequence number of the newest record.
+     *
+     * @return The sequence number, counting the saves since the store was first used.
+     */
+    uint16_t getSequence() const;
+
+    /**
+     * @brief Gets the number of slots the records rotate through.
+     *
+     * @return The number of slots that fit in the EEPROM.
+     */
+    byte slotCount() const;
+
+private:
+    /**
+     * @brief Finds the newest valid slot, sets `_newest` (-1 when none) and `_sequence`.
+     */
+    void scan();
+
+    /**
+     * @brief Gets the EEPROM address of a slot.
+     */
+    int address(byte slot) const;
+
+    /**
+     * @brief Computes the CRC of a slot as stored in EEPROM (sequence, version and record).
+     */
+    uint16_t storedCrc(byte slot) const;
+
+    /**
+     * @brief The layout version of the record.
+     */
+    byte _version;
+
+    /**
+     * @brief The size of the record in bytes.
+     */
+    uint16_t _size;
+
+    /**
+     * @brief The number of slots.
+     */
+    byte _slots;
+
+    /**
+     * @brief The slot holding the newest record, -1 when the store is empty.
+     */
+    int _newest = -1;
+
+    /**
+     * @brief The sequence number of the newest record.
+     */
+    uint16_t _sequence = 0;
+
+    /**
+     * @brief Whether `scan()` has run since power up.
+     */
+    bool _scanned = false;
+
+    /**
+     * @brief The record of the queued save.
+     */
+    const byte* _record = nullptr;
+
+    /**
+     * @brief What the queued save does next (idle, compare, record or header).
+     */
+    byte _phase = 0;
+
+    /**
+     * @brief The next byte of the phase.
+     */
+    uint16_t _step = 0;
+
+    /**
+     * @brief The CRC of the bytes written so far.
+     */
+    uint16_t _crc = 0;
+
+    /**
+     * @brief The slot being written.
+     */
+    byte _slot = 0;
+};
+#endif
@@ -0,0 +1,200 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Amit's SysEx message helpers.
+ *****************************************************************************/
+
+#include "ATSYSEX.h"
+
+/**
+ * @brief Starts a new message with the header and the given command.
+ *
+ * @param command The command byte (0-127).
+ */
+ATSYSEX::ATSYSEX(byte command)
+{
+    put7(SYSEX_MANUFACTURER);
+    put7(SYSEX_DEVICE);
+    put7(command);
+}
+
+/**
+ * @brief Appends a 7 bit value.
+ *
+ * @param value The value (0-127).
+ *
+ * @details Bytes that do not fit in the message are dropped.
+ */
+void ATSYSEX::put7(byte value)
+{
+    if (_length < SYSEX_MAX_SIZE) {
+        _data[_length++] = value & 0x7F;
+    }
+}
+
+/**
+ * @brief Appends a 16 bit value as 3 septets.
+ *
+ * @param value The value.
+ */
+void ATSYSEX::put16(uint16_t value)
+{
+    putSeptets(value, 3);
+}
+
+/**
+ * @brief Appends a 32 bit value as 5 septets.
+ *
+ * @param value The value.
+ */
+void ATSYSEX::put32(uint32_t value)
+{
+    putSeptets(value, 5);
+}
+
+/**
+ * @brief Appends the checksum of the payload (everything after the command byte).
+ */
+void ATSYSEX::putChecksum()
+{
+    put7(checksum(_data + 3, _length - 3));
+}
+
+/**
+ * @brief Appends 8 bit data, packed 7 bytes into 8 septets.
+ *
+ * @param data The bytes to append.
+ * @param count The number of bytes.
+ *
+ * @details Groups that do not fit in the message whole are dropped.
+ */
+void ATSYSEX::putPacked(const byte* data, byte count)
+{
+    for (byte i = 0; i < count; i += 7) {
+        byte group = min(count - i, 7);
+        if (_length + group + 1 > SYSEX_MAX_SIZE) {
+            return;
+        }
+        byte high = 0;
+        for (byte j = 0; j < group; j++) {
+            high |= (data[i + j] >> 7) << j;
+        }
+        put7(high);
+        for (byte j = 0; j < group; j++) {
+            put7(data[i + j]);
+        }
+    }
+}
+
+/**
+ * @brief Appends a value as the given number of septets, least significant first.
+ */
+void ATSYSEX::putSeptets(uint32_t value, byte count)
+{
+    for (byte i = 0; i < count; i++) {
+        put7(value & 0x7F);
+        value >>= 7;
+    }
+}
+
+/**
+ * @brief Gets the message bytes, without F0/F7.
+ *
+ * @return Pointer to the message bytes.
+ */
+const byte* ATSYSEX::data() const
+{
+    return _data;
+}
+
+/**
+ * @brief Gets the message length, without F0/F7.
+ *
+ * @return The number of bytes in the message.
+ */
+byte ATSYSEX::length() const
+{
+    return _length;
+}
+
+/**
+ * @brief Checks whether a received SysEx message is addressed to this pedal.
+ *
+ * @param message The received message, including F0 and F7.
+ * @param length The length of the received message.
+ * @return The command byte, or -1 when the message is not for this pedal.
+ */
+int ATSYSEX::command(const byte* message, unsigned length)
+{
+    if (length < 5 || message[1] != SYSEX_MANUFACTURER || message[2] != SYSEX_DEVICE) {
+        return -1;
+    }
+    return message[3];
+}
+
+/**
+ * @brief Reads a 16 bit value sent as 3 septets.
+ *
+ * @param data Pointer to the first septet.
+ * @return The decoded value.
+ */
+uint16_t ATSYSEX::get16(const byte* data)
+{
+    return data[0] | ((uint16_t)data[1] << 7) | ((uint16_t)data[2] << 14);
+}
+
+/**
+ * @brief Reads a 32 bit value sent as 5 septets.
+ *
+ * @param data Pointer to the first septet.
+ * @return The decoded value.
+ */
+uint32_t ATSYSEX::get32(const byte* data)
+{
+    uint32_t value = 0;
+    for (byte i = 5; i > 0; i--) {
+        value = (value << 7) | (data[i - 1] & 0x7F);
+    }
+    return value;
+}
+
+/**
+ * @brief Unpacks 8 bit data appended with `putPacked()`.
+ *
+ * @param data Pointer to the first septet.
+ * @param length The number of septets.
+ * @param out Receives the bytes, room for `length` bytes is enough.
+ * @return The number of bytes unpacked.
+ */
+unsigned ATSYSEX::getPacked(const byte* data, unsigned length, byte* out)
+{
+    unsigned count = 0;
+    for (unsigned i = 0; i < length; i += 8) {
+        byte high = data[i];
+        for (unsigned j = 1; j < 8 && i + j < length; j++) {
+            out[count++] = (data[i + j] & 0x7F) | (((high >> (j - 1)) & 1) << 7);
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Computes the checksum of a payload.
+ *
+ * @param data Pointer to the first payload byte.
+ * @param length The number of payload bytes.
+ * @return The byte that makes the 7 bit sum zero, so a payload that ends with its
+ *         checksum gives 0.
+ */
+byte ATSYSEX::checksum(const byte* data, unsigned length)
+{
+    byte sum = 0;
+    for (unsigned i = 0; i < length; i++) {
+        sum += data[i];
+    }
+    return (0x80 - (sum & 0x7F)) & 0x7F;
+}
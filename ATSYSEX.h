@@ -0,0 +1,145 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's SysEx message helpers.
+ *****************************************************************************/
+
+#ifndef ATSYSEX_H
+#define ATSYSEX_H
+#include <Arduino.h>
+
+/** @brief SysEx manufacturer ID (0x7D, non-commercial / educational use). */
+#define SYSEX_MANUFACTURER 0x7D
+/** @brief SysEx device byte identifying an Amit Expresso ('A'). */
+#define SYSEX_DEVICE 0x41
+/** @brief Maximum size of a SysEx message built with `ATSYSEX`, without F0/F7. */
+#define SYSEX_MAX_SIZE 64
+
+/**
+ * @brief Builds and parses the pedal's SysEx messages.
+ *
+ * @details Every message has the form `F0 7D 41 <command> <payload> F7`. Multi byte
+ *          values are sent least significant septet first: 16 bit values take 3 bytes
+ *          and 32 bit values take 5 bytes, so every payload byte stays below 0x80.
+ *          The builder holds the message without F0/F7, ready for
+ *          `MIDI.sendSysEx(length(), data(), false)`.
+ */
+class ATSYSEX {
+
+public:
+    /**
+     * @brief Starts a new message with the header and the given command.
+     *
+     * @param command The command byte (0-127).
+     */
+    ATSYSEX(byte command);
+
+    /**
+     * @brief Appends a 7 bit value.
+     *
+     * @param value The value (0-127).
+     */
+    void put7(byte value);
+
+    /**
+     * @brief Appends a 16 bit value as 3 septets.
+     *
+     * @param value The value.
+     */
+    void put16(uint16_t value);
+
+    /**
+     * @brief Appends a 32 bit value as 5 septets.
+     *
+     * @param value The value.
+     */
+    void put32(uint32_t value);
+
+    /**
+     * @brief Appends the checksum of the payload (everything after the command byte).
+     *
+     * @details The checksum makes the 7 bit sum of the payload, checksum included, zero.
+     */
+    void putChecksum();
+
+    /**
+     * @brief Appends 8 bit data, packed 7 bytes into 8 septets.
+     *
+     * @param data The bytes to append.
+     * @param count The number of bytes.
+     *
+     * @details Every group of up to 7 bytes starts with a septet holding their top bits (bit 0 for
+     *          the first byte), followed by their low 7 bits.
+     */
+    void putPacked(const byte* data, byte count);
+
+    /**
+     * @brief Gets the message bytes, without F0/F7.
+     *
+     * @return Pointer to the message bytes.
+     */
+    const byte* data() const;
+
+    /**
+     * @brief Gets the message length, without F0/F7.
+     *
+     * @return The number of bytes in the message.
+     */
+    byte length() const;
+
+    /**
+     * @brief Checks whether a received SysEx message is addressed to this pedal.
+     *
+     * @param message The received message, including F0 and F7.
+     * @param length The length of the received message.
+     * @return The command byte, or -1 when the message is not for this pedal.
+     */
+    static int command(const byte* message, unsigned length);
+
+    /**
+     * @brief Reads a 16 bit value sent as 3 septets.
+     *
+     * @param data Pointer to the first septet.
+     * @return The decoded value.
+     */
+    static uint16_t get16(const byte* data);
+
+    /**
+     * @brief Reads a 32 bit value sent as 5 septets.
+     *
+     * @param data Pointer to the first septet.
+     * @return The decoded value.
+     */
+    static uint32_t get32(const byte* data);
+
+    /**
+     * @brief Unpacks 8 bit data appended with `putPacked()`.
+     *
+     * @param data Pointer to the first septet.
+     * @param length The number of septets.
+     * @param out Receives the bytes, room for `length` bytes is enough.
+     * @return The number of bytes unpacked.
+     */
+    static unsigned getPacked(const byte* data, unsigned length, byte* out);
+
+    /**
+     * @brief Computes the checksum of a payload.
+     *
+     * @param data Pointer to the first payload byte.
+     * @param length The number of payload bytes.
+     * @return The byte that makes the 7 bit sum zero, so a payload that ends with its
+     *         checksum gives 0.
+     */
+    static byte checksum(const byte* data, unsigned length);
+
+private:
+    void putSeptets(uint32_t value, byte count);
+
+    byte _data[SYSEX_MAX_SIZE];
+    byte _length = 0;
+};
+#endif
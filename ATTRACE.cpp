@@ -0,0 +1,329 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Amit's raw pot sample trace recorder.
+ *****************************************************************************/
+
+#include "ATTRACE.h"
+
+/** @brief Code of a run of samples equal to the previous one, followed by the length - 1. */
+#define CODE_RUN 13
+/** @brief Code of a gap, followed by the number of samples missing in 3 nibbles. */
+#define CODE_GAP 14
+/** @brief Code of an absolute sample, followed by its value in 3 nibbles. */
+#define CODE_VALUE 15
+/** @brief Longest zero run one code holds. */
+#define MAX_RUN 16
+/** @brief Longest gap one code holds. */
+#define MAX_GAP 4095
+
+/**
+ * @brief Constructor for the ATTRACE class, starts stopped with an empty buffer.
+ */
+ATTRACE::ATTRACE()
+{
+}
+
+/**
+ * @brief Starts recording with the next sample.
+ *
+ * @param every Keep every n-th sample (1-255).
+ */
+void ATTRACE::start(byte every)
+{
+    _nibbles = 0;
+    _samples = 0;
+    _gap = 0;
+    _run = 0;
+    _every = max(every, 1);
+    _counting = false;
+    _state = ATTRACE_RECORDING;
+}
+
+/**
+ * @brief Starts recording once the pot moves.
+ *
+ * @param every Keep every n-th sample (1-255).
+ * @param trigger Distance from the first sample seen that starts the recording (raw steps).
+ *
+ * @details The sample that crossed the trigger is the first one recorded.
+ */
+void ATTRACE::arm(byte every, byte trigger)
+{
+    start(every);
+    _trigger = trigger;
+    _last = -1;
+    _state = ATTRACE_ARMED;
+}
+
+/**
+ * @brief Stops recording, the buffer keeps the trace.
+ *
+ * @details Writes the zero run that is waiting, there is always room left for it.
+ */
+void ATTRACE::stop()
+{
+    if (_state == ATTRACE_RECORDING) {
+        flush();
+    }
+    if (_state != ATTRACE_FULL) {
+        _state = ATTRACE_STOPPED;
+    }
+}
+
+/**
+ * @brief Adds one raw sample.
+ *
+ * @param sample The reading (0-1023).
+ *
+ * @details Samples between the kept ones only count towards the gap. A sample equal to the previous
+ *          one only extends the zero run, which is written once it is full or another code follows.
+ */
+void ATTRACE::add(int sample)
+{
+    if (_state == ATTRACE_ARMED) {
+        if (_last < 0) {
+            _last = sample;
+            return;
+        }
+        if (abs(sample - _last) < _trigger) {
+            return;
+        }
+        _state = ATTRACE_RECORDING;
+    }
+    if (_state != ATTRACE_RECORDING) {
+        return;
+    }
+
+    if (!_samples) {
+        put12(CODE_VALUE, sample);
+        startedAt = micros();
+        _last = sample;
+        _samples = 1;
+        _gap = 0;
+        return;
+    }
+    if (++_gap < _every) {
+        return;
+    }
+
+    uint16_t extra = _gap - _every;
+    int delta = sample - _last;
+    bool small = delta >= -6 && delta <= 6;
+    byte nibbles = 0;
+    if (extra || delta) {
+        nibbles = (_run ? 2 : 0) + 4 * ((extra + (unsigned long)MAX_GAP - 1) / MAX_GAP) + (small ? 1 : 4);
+    } else if (_run == MAX_RUN) {
+        nibbles = 2;
+    }
+    if (!fits(nibbles)) {
+        stop();
+        _state = ATTRACE_FULL;
+        return;
+    }
+
+    if (extra || delta) {
+        flush();
+        while (extra) {
+            uint16_t gap = min(extra, MAX_GAP);
+            put12(CODE_GAP, gap);
+            extra -= gap;
+        }
+        if (!delta) {
+            _run = 1; // a zero delta has no code of its own
+        } else if (small) {
+            put(delta < 0 ? delta + 7 : delta + 6);
+        } else {
+            put12(CODE_VALUE, sample);
+        }
+    } else {
+        if (_run == MAX_RUN) {
+            flush();
+        }
+        _run++;
+    }
+    _last = sample;
+    _samples++;
+    _gap = 0;
+}
+
+/**
+ * @brief Notes the drop count of the sample source.
+ *
+ * @param total The number of samples dropped so far.
+ *
+ * @details The first call after `start()` only takes the count as it is.
+ */
+void ATTRACE::dropped(uint16_t total)
+{
+    uint16_t lost = total - _dropped;
+    _dropped = total;
+    if (_counting && lost && _state == ATTRACE_RECORDING && _samples) {
+        _gap = (uint16_t)(_gap + lost) < _gap ? 0xFFFF : _gap + lost;
+    }
+    _counting = true;
+}
+
+/**
+ * @brief Gets the state.
+ *
+ * @return `ATTRACE_STOPPED` ... `ATTRACE_FULL`.
+ */
+byte ATTRACE::state() const
+{
+    return _state;
+}
+
+/**
+ * @brief Checks whether the trace is armed or recording.
+ *
+ * @return true while samples may still be recorded.
+ */
+bool ATTRACE::isRunning() const
+{
+    return _state == ATTRACE_ARMED || _state == ATTRACE_RECORDING;
+}
+
+/**
+ * @brief Gets the number of samples kept between two recorded samples.
+ *
+ * @return The n of `start()`.
+ */
+byte ATTRACE::every() const
+{
+    return _every;
+}
+
+/**
+ * @brief Gets the number of recorded samples.
+ *
+ * @return The count, including the samples of a zero run still waiting to be written.
+ */
+uint16_t ATTRACE::samples() const
+{
+    return _samples;
+}
+
+/**
+ * @brief Gets the recorded data.
+ *
+ * @return Pointer to the first byte of the code stream.
+ */
+const byte* ATTRACE::data() const
+{
+    return _data;
+}
+
+/**
+ * @brief Gets the length of the recorded data.
+ *
+ * @return The number of bytes used.
+ */
+uint16_t ATTRACE::length() const
+{
+    return (_nibbles + 1) / 2;
+}
+
+/**
+ * @brief Decodes a recorded trace.
+ *
+ * @param data The code stream.
+ * @param length The number of bytes.
+ * @param every The n the trace was recorded with.
+ * @param sample Called for each sample, with its index in source samples and its value.
+ * @return The number of decoded samples.
+ *
+ * @details Stops at a code cut off by the end of the data.
+ */
+uint16_t ATTRACE::decode(const byte* data, uint16_t length, byte every, void (*sample)(unsigned long index, int value))
+{
+    unsigned long index = 0;
+    unsigned long nibbles = 2UL * length;
+    uint16_t count = 0;
+    int value = 0;
+    for (unsigned long i = 0; i < nibbles;) {
+        byte code = (data[i >> 1] >> ((i & 1) ? 0 : 4)) & 0x0F;
+        i++;
+        byte repeat = 1;
+        if (code == 0) {
+            continue;
+        } else if (code == CODE_RUN) {
+            if (i >= nibbles) {
+                break;
+            }
+            repeat = ((data[i >> 1] >> ((i & 1) ? 0 : 4)) & 0x0F) + 1;
+            i++;
+        } else if (code >= CODE_GAP) {
+            if (i + 3 > nibbles) {
+                break;
+            }
+            uint16_t field = 0;
+            for (byte n = 0; n < 3; n++, i++) {
+                field = (field << 4) | ((data[i >> 1] >> ((i & 1) ? 0 : 4)) & 0x0F);
+            }
+            if (code == CODE_GAP) {
+                index += field;
+                continue;
+            }
+            value = field;
+        } else {
+            value += code <= 6 ? code - 7 : code - 6;
+        }
+        for (byte n = 0; n < repeat; n++) {
+            if (count) {
+                index += every;
+            }
+            sample(index, value);
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Checks whether codes of the given size fit, keeping room to write a zero run after them.
+ */
+bool ATTRACE::fits(byte nibbles) const
+{
+    return _nibbles + nibbles + 2 <= 2 * ATTRACE_BYTES;
+}
+
+/**
+ * @brief Appends one code or value nibble.
+ */
+void ATTRACE::put(byte nibble)
+{
+    if (_nibbles & 1) {
+        _data[_nibbles >> 1] |= nibble;
+    } else {
+        _data[_nibbles >> 1] = nibble << 4;
+    }
+    _nibbles++;
+}
+
+/**
+ * @brief Appends a code followed by a 12 bit value, most significant nibble first.
+ */
+void ATTRACE::put12(byte code, uint16_t value)
+{
+    put(code);
+    put((value >> 8) & 0x0F);
+    put((value >> 4) & 0x0F);
+    put(value & 0x0F);
+}
+
+/**
+ * @brief Writes the zero run that is waiting.
+ */
+void ATTRACE::flush()
+{
+    if (_run) {
+        put(CODE_RUN);
+        put(_run - 1);
+        _run = 0;
+    }
+}
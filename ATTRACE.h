@@ -0,0 +1,177 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's raw pot sample trace recorder.
+ *****************************************************************************/
+
+#ifndef ATTRACE_H
+#define ATTRACE_H
+#include <Arduino.h>
+
+/**
+ * @brief Size of the trace buffer in bytes, one to two samples per byte, many more at rest.
+ */
+#ifndef ATTRACE_BYTES
+#define ATTRACE_BYTES 384
+#endif
+
+/** @brief Trace state: not recording, the buffer keeps the last trace. */
+#define ATTRACE_STOPPED 0
+/** @brief Trace state: waiting for the pot to move. */
+#define ATTRACE_ARMED 1
+/** @brief Trace state: recording. */
+#define ATTRACE_RECORDING 2
+/** @brief Trace state: stopped because the buffer is full. */
+#define ATTRACE_FULL 3
+
+/**
+ * @brief Records the raw samples of a pot, delta encoded, for replay on the host.
+ *
+ * @details Gets every raw sample handed to it by `ATPOT::setTrace()` and keeps every n-th one.
+ *          Samples are taken at a fixed rate (the ADC engine's), so no times are stored: sample k
+ *          was taken k times the sample period after the first, samples the engine dropped are
+ *          recorded as a gap. The buffer holds a stream of 4 bit codes, high nibble first:
+ *          - 0: nothing, pads the last byte.
+ *          - 1-12: the next sample differs from the previous one by -6 ... -1, +1 ... +6.
+ *          - 13 + 1 nibble n: the next n + 1 samples equal the previous one.
+ *          - 14 + 3 nibbles g: the next sample comes g samples later than it would (1-4095).
+ *          - 15 + 3 nibbles v: the next sample is v (0-1023), the first sample always is.
+ *          Multi nibble values are most significant nibble first. A pot at rest takes half a
+ *          byte per sample or less, the buffer stops recording when the next code no longer fits.
+ */
+class ATTRACE {
+
+public:
+    /**
+     * @brief Constructor for the ATTRACE class, starts stopped with an empty buffer.
+     */
+    ATTRACE();
+
+    /**
+     * @brief Starts recording with the next sample.
+     *
+     * @param every Keep every n-th sample (1-255).
+     */
+    void start(byte every);
+
+    /**
+     * @brief Starts recording once the pot moves.
+     *
+     * @param every Keep every n-th sample (1-255).
+     * @param trigger Distance from the first sample seen that starts the recording (raw steps).
+     */
+    void arm(byte every, byte trigger);
+
+    /**
+     * @brief Stops recording, the buffer keeps the trace.
+     */
+    void stop();
+
+    /**
+     * @brief Adds one raw sample.
+     *
+     * @param sample The reading (0-1023).
+     */
+    void add(int sample);
+
+    /**
+     * @brief Notes the drop count of the sample source.
+     *
+     * @param total The number of samples dropped so far.
+     *
+     * @details Samples dropped since the last call are recorded as a gap before the next sample.
+     */
+    void dropped(uint16_t total);
+
+    /**
+     * @brief Gets the state.
+     *
+     * @return `ATTRACE_STOPPED` ... `ATTRACE_FULL`.
+     */
+    byte state() const;
+
+    /**
+     * @brief Checks whether the trace is armed or recording.
+     *
+     * @return true while samples may still be recorded.
+     */
+    bool isRunning() const;
+
+    /**
+     * @brief Gets the number of samples kept between two recorded samples.
+     *
+     * @return The n of `start()`.
+     */
+    byte every() const;
+
+    /**
+     * @brief Gets the number of recorded samples.
+     *
+     * @return The count, including the samples of a zero run still waiting to be written.
+     */
+    uint16_t samples() const;
+
+    /**
+     * @brief Gets the recorded data.
+     *
+     * @return Pointer to the first byte of the code stream.
+     */
+    const byte* data() const;
+
+    /**
+     * @brief Gets the length of the recorded data.
+     *
+     * @return The number of bytes used.
+     */
+    uint16_t length() const;
+
+    /**
+     * @brief Decodes a recorded trace.
+     *
+     * @param data The code stream.
+     * @param length The number of bytes.
+     * @param every The n the trace was recorded with.
+     * @param sample Called for each sample, with its index in source samples and its value.
+     * @return The number of decoded samples.
+     */
+    static uint16_t decode(const byte* data, uint16_t length, byte every, void (*sample)(unsigned long index, int value));
+
+    /**
+     * @brief Time the first sample was recorded (micros).
+     */
+    unsigned long startedAt = 0;
+
+private:
+    /**
+     * @brief Checks whether codes of the given size fit, keeping room to write a zero run after them.
+     */
+    bool fits(byte nibbles) const;
+
+    void put(byte nibble);
+    void put12(byte code, uint16_t value);
+
+    /**
+     * @brief Writes the zero run that is waiting.
+     */
+    void flush();
+
+    byte _data[ATTRACE_BYTES];
+    uint16_t _nibbles = 0;
+    uint16_t _samples = 0;
+    uint16_t _gap = 0;
+    uint16_t _dropped = 0;
+    int _last = 0;
+    /**
+     * @brief Samples equal to the previous one that are waiting to be written as one code.
+     */
+    byte _run = 0;
+    byte _every = 1;
+    byte _trigger = 0;
+    byte _state = ATTRACE_STOPPED;
+    bool _counting = false;
+};
+#endif
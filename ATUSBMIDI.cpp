@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Amit's batched USB-MIDI packet writer.
+ *****************************************************************************/
+
+#include "ATUSBMIDI.h"
+
+/**
+ * @brief Sets the maximum time a packet is held before `update()` writes it.
+ *
+ * @param us The hold time in microseconds, 0 writes on every `update()` that has packets.
+ */
+void ATUSBMIDI::setMaxHold(unsigned long us)
+{
+    _maxHold = us;
+}
+
+/**
+ * @brief Buffers a Control Change message.
+ *
+ * @param cc The MIDI CC number.
+ * @param value The CC value (0-127).
+ * @param ch The MIDI channel (1-16).
+ *
+ * @details Builds the USB-MIDI event packet (cable 0, code index 0xB). For an MSB controller
+ *          the buffer is written first unless two packets are free, so the LSB that follows
+ *          can not be split into the next transfer.
+ */
+void ATUSBMIDI::controlChange(byte cc, byte value, byte ch)
+{
+    midiEventPacket_t packet = { 0x0B, (byte)(0xB0 | ((ch - 1) & 0x0F)), (byte)(cc & 0x7F), (byte)(value & 0x7F) };
+    add(packet, cc < 32 ? 2 : 1);
+}
+
+/**
+ * @brief Writes the buffered packets when the oldest one has been held for the hold time.
+ */
+void ATUSBMIDI::update()
+{
+    if (_count && (micros() - _heldSince) >= _maxHold) {
+        flush();
+    }
+}
+
+/**
+ * @brief Writes all buffered packets now, in one transfer.
+ *
+ * @details One bulk write of all the packets followed by a single flush of the endpoint.
+ */
+void ATUSBMIDI::flush()
+{
+    if (!_count) {
+        return;
+    }
+    MidiUSB.write((const uint8_t*)_packets, _count * sizeof(midiEventPacket_t));
+    MidiUSB.flush();
+    transferCount++;
+    packetCount += _count;
+    _count = 0;
+}
+
+/**
+ * @brief Appends one packet, writing the buffer first when fewer than `room` packets are free.
+ */
+void ATUSBMIDI::add(const midiEventPacket_t& packet, byte room)
+{
+    if (_count > ATUSBMIDI_PACKETS - room) {
+        flush();
+    }
+    if (!_count) {
+        _heldSince = micros();
+    }
+    _packets[_count++] = packet;
+}
@@ -0,0 +1,100 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Header File for Amit's batched USB-MIDI packet writer.
+ *****************************************************************************/
+
+#ifndef ATUSBMIDI_H
+#define ATUSBMIDI_H
+#include <Arduino.h>
+#include <MIDIUSB.h>
+
+/**
+ * @brief Number of 4 byte USB-MIDI event packets collected before a write (at most 16, one 64 byte endpoint buffer).
+ */
+#define ATUSBMIDI_PACKETS 8
+
+/**
+ * @brief Default maximum time a packet is held before it is written, one full speed USB frame (us).
+ */
+#define ATUSBMIDI_HOLD_US 1000
+
+/**
+ * @brief Collects USB-MIDI event packets and writes them to the MIDI endpoint in one transfer.
+ *
+ * @details Every message sent through the MIDI library is its own USB transfer. This writer
+ *          buffers the Control Change messages of a loop pass (and of the passes that follow within
+ *          the hold time) and hands them to the endpoint as a single bulk write. The host polls the
+ *          endpoint once per 1 ms frame anyway, so holding a packet up to a frame adds no latency
+ *          the host would notice. An MSB controller (CC 0-31) is only buffered when there is room
+ *          for its LSB too, so a 14 bit pair always ends up in the same transfer.
+ */
+class ATUSBMIDI {
+
+public:
+    /**
+     * @brief Sets the maximum time a packet is held before `update()` writes it.
+     *
+     * @param us The hold time in microseconds, 0 writes on every `update()` that has packets.
+     */
+    void setMaxHold(unsigned long us);
+
+    /**
+     * @brief Buffers a Control Change message.
+     *
+     * @param cc The MIDI CC number.
+     * @param value The CC value (0-127).
+     * @param ch The MIDI channel (1-16).
+     */
+    void controlChange(byte cc, byte value, byte ch);
+
+    /**
+     * @brief Writes the buffered packets when the oldest one has been held for the hold time.
+     *
+     * @details Call this once at the end of every pass of the main loop.
+     */
+    void update();
+
+    /**
+     * @brief Writes all buffered packets now, in one transfer.
+     */
+    void flush();
+
+    /**
+     * @brief Number of USB transfers written.
+     */
+    unsigned long transferCount = 0;
+
+    /**
+     * @brief Number of event packets written.
+     */
+    unsigned long packetCount = 0;
+
+private:
+    /**
+     * @brief Appends one packet, writing the buffer first when fewer than `room` packets are free.
+     */
+    void add(const midiEventPacket_t& packet, byte room);
+
+    midiEventPacket_t _packets[ATUSBMIDI_PACKETS];
+
+    /**
+     * @brief Number of buffered packets.
+     */
+    byte _count = 0;
+
+    /**
+     * @brief Time the oldest buffered packet was added (micros).
+     */
+    unsigned long _heldSince = 0;
+
+    /**
+     * @brief Maximum time a packet is held in microseconds.
+     */
+    unsigned long _maxHold = ATUSBMIDI_HOLD_US;
+};
+#endif
@@ -0,0 +1,86 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Minimal mock of the Arduino core, used to build the pot classes on a desktop.
+ * Only what ATPOTS.cpp, ATADC.cpp, ATMIDIOUT.cpp and ATDINMIDI.cpp need is provided.
+ *****************************************************************************/
+
+#ifndef HOSTSIM_ARDUINO_H
+#define HOSTSIM_ARDUINO_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+typedef uint8_t byte;
+
+#define HIGH 1
+#define LOW 0
+#define A0 18
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define analogPinToChannel(P) (P)
+#define noInterrupts()
+#define interrupts()
+#define PROGMEM
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+int analogRead(uint8_t pin);
+unsigned long millis();
+unsigned long micros();
+
+/**
+ * @brief Serial port stub, counts the bytes written.
+ *
+ * @details Models the transmit ring buffer of the hardware serial port: bytes leave it at the
+ *          baud rate set with `begin()` on the simulated clock, and a write to a full buffer
+ *          waits (advances the clock) until a byte has gone out, like the Arduino core does.
+ */
+class HostSerial {
+public:
+    void begin(unsigned long baud);
+    int availableForWrite();
+    size_t write(uint8_t value);
+    unsigned long written = 0;
+
+private:
+    void drain();
+    unsigned long _byteUS = 0;
+    unsigned long _sentAt = 0;
+    int _queued = 0;
+};
+typedef HostSerial HardwareSerial;
+extern HostSerial Serial;
+extern HostSerial Serial1;
+
+/**
+ * @brief Controls for the simulated hardware.
+ */
+namespace hostsim {
+/**
+ * @brief Simulated time in microseconds, returned by `micros()` and `millis()`.
+ */
+extern unsigned long now;
+
+/**
+ * @brief Signal returned by `analogRead()`, as a function of the simulated time.
+ */
+extern int (*signal)(unsigned long us);
+
+/**
+ * @brief Time one `analogRead()` call takes on the 32u4 (in microseconds), added to `now`.
+ */
+const unsigned long ANALOG_READ_US = 112;
+
+/**
+ * @brief Size of the simulated serial transmit buffer, as in the Arduino core.
+ */
+const int SERIAL_TX_BUFFER = 64;
+}
+#endif
@@ -0,0 +1,365 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Host benchmark for the ATPOT filter, replays ADC traces through the real
+ * ATADC -> ATPOT -> ATMIDIOUT pipeline on a simulated clock.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++11 -O2 -Iextras/hostsim -I. ATPOTS.cpp ATADC.cpp ATMIDIOUT.cpp ATDINMIDI.cpp ATTRACE.cpp \
+ *       extras/hostsim/hostsim.cpp extras/hostsim/bench.cpp -o bench
+ *
+ * Run:
+ *   ./bench              synthetic traces (noisy idle, step, sweep)
+ *   ./bench trace.txt    replay a recorded trace, one "value" or "time_us value" per line
+ *
+ * The output is deterministic, so it can be diffed between two versions of the filter.
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ATADC.h"
+#include "ATMIDIOUT.h"
+#include "ATPOTS.h"
+
+/** @brief Time between two free-running conversions at ADC prescaler 128 (13 cycles at 125 kHz). */
+const unsigned long CONVERSION_US = 104;
+/** @brief Simulated time the rest of loop() takes per pass (sustain, MIDI input, USB). */
+const unsigned long LOOP_US = 30;
+/** @brief Rate limit used for the "sent" column, the sketch default. */
+const unsigned int RATE = 200;
+/** @brief Time given to the filter to settle before idle chatter is counted. */
+const unsigned long WARMUP_US = 50000;
+/** @brief Maximum number of samples in a replayed trace. */
+const unsigned long MAX_REPLAY = 200000;
+
+/**
+ * @brief One filter configuration to evaluate.
+ */
+struct Config {
+    int readings;
+    int threshold;
+    float deadZone;
+    byte hysteresis;
+    byte smoothing; ///< adaptive filter, 0 = off
+    byte response;
+    bool engine;
+};
+
+/**
+ * @brief Kind of trace, decides which metrics are meaningful.
+ */
+enum Kind { IDLE, STEP, SWEEP, REPLAY };
+
+/**
+ * @brief A signal to replay, with its noise free version for the error metrics.
+ */
+struct Trace {
+    const char* name;
+    Kind kind;
+    unsigned long duration;
+    int (*signal)(unsigned long us);
+    int (*clean)(unsigned long us);
+};
+
+/** @brief Time of the step in the step trace. */
+const unsigned long STEP_AT = 100000;
+
+static unsigned long replayTimes[MAX_REPLAY];
+static int replayValues[MAX_REPLAY];
+static unsigned long replayCount = 0;
+
+/**
+ * @brief Deterministic noise in [-8, 8] LSB (roughly gaussian, sigma ~2.3), a pure function of time.
+ */
+static int noise(unsigned long us)
+{
+    unsigned long h = us * 2654435761UL;
+    h ^= h >> 15;
+    h *= 2246822519UL;
+    h ^= h >> 13;
+    int sum = 0;
+    for (int i = 0; i < 4; i++) {
+        sum += (h >> (i * 8)) & 0xFF;
+    }
+    int spike = ((h >> 3) % 1000) == 0 ? 40 : 0; // rare single sample spike
+    return (sum - 510) / 64 + spike;
+}
+
+static int clamp(int value)
+{
+    return constrain(value, 0, MAX_ANALOG_POT_READING);
+}
+
+static int idleClean(unsigned long) { return 512; } // right on the 63/64 output step boundary
+static int idleSignal(unsigned long us) { return clamp(idleClean(us) + noise(us)); }
+
+static int stepClean(unsigned long us) { return us < STEP_AT ? 200 : 820; }
+static int stepSignal(unsigned long us) { return clamp(stepClean(us) + noise(us)); }
+
+static int sweepClean(unsigned long us)
+{
+    // hold, 200 ms up, 200 ms down, hold
+    if (us < 50000)
+        return 0;
+    if (us < 250000)
+        return (us - 50000) * MAX_ANALOG_POT_READING / 200000;
+    if (us < 450000)
+        return MAX_ANALOG_POT_READING - (us - 250000) * MAX_ANALOG_POT_READING / 200000;
+    return 0;
+}
+static int sweepSignal(unsigned long us) { return clamp(sweepClean(us) + noise(us)); }
+
+static int replaySignal(unsigned long us)
+{
+    // sample and hold between the recorded timestamps
+    unsigned long lo = 0, hi = replayCount;
+    while (hi - lo > 1) {
+        unsigned long mid = (lo + hi) / 2;
+        if (replayTimes[mid] <= us)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return replayValues[lo];
+}
+
+/**
+ * @brief Loads a recorded trace, one "value" or "time_us value" per line.
+ */
+static bool loadReplay(const char* path)
+{
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    char line[64];
+    while (replayCount < MAX_REPLAY && fgets(line, sizeof(line), file)) {
+        unsigned long t;
+        int v;
+        int fields = sscanf(line, "%lu %d", &t, &v);
+        if (fields == 1) {
+            v = (int)t;
+            t = replayCount * CONVERSION_US;
+        } else if (fields != 2) {
+            continue;
+        }
+        replayTimes[replayCount] = t;
+        replayValues[replayCount] = clamp(v);
+        replayCount++;
+    }
+    fclose(file);
+    return replayCount > 0;
+}
+
+/**
+ * @brief What one run measured.
+ */
+struct Result {
+    unsigned long events; ///< changed() calls
+    unsigned long sent; ///< CC messages after the rate limiter
+    unsigned long idleEvents; ///< changed() calls after the warmup (idle trace)
+    int spanLo, spanHi; ///< output range after the warmup (idle trace)
+    long firstLatency; ///< step to first CC in us, -1 when none
+    long settleLatency; ///< step to final value in us, -1 when never reached
+    int finalError; ///< last output minus ideal output
+    double meanError; ///< mean |output - ideal| while sweeping, in output steps
+    int maxError; ///< max |output - ideal| while sweeping, in output steps
+};
+
+static Result result;
+static int output = -1;
+static int finalValue = 0;
+static long reachedAt = -1;
+static ATMIDIOUT* out = nullptr;
+
+static void onSend(byte, byte, byte)
+{
+    result.sent++;
+}
+
+static void onChange(byte newValue, byte)
+{
+    unsigned long now = hostsim::now;
+    result.events++;
+    output = newValue;
+    if (now >= WARMUP_US) {
+        result.idleEvents++;
+        result.spanLo = min(result.spanLo, (int)newValue);
+        result.spanHi = max(result.spanHi, (int)newValue);
+    }
+    if (now >= STEP_AT && result.firstLatency < 0) {
+        result.firstLatency = now - STEP_AT;
+    }
+    if (newValue == finalValue) {
+        if (reachedAt < 0)
+            reachedAt = now;
+    } else {
+        reachedAt = -1;
+    }
+    out->send(11, newValue, 1);
+}
+
+/**
+ * @brief The output the pot would give for a noise free reading, through the same transfer function.
+ */
+static int ideal(const ATPOT& reference, int raw)
+{
+    return reference.scale(reference.transfer(raw));
+}
+
+static Result run(const Trace& trace, const Config& config)
+{
+    memset(&result, 0, sizeof(result));
+    result.spanLo = 127;
+    result.firstLatency = -1;
+    result.settleLatency = -1;
+    output = -1;
+    reachedAt = -1;
+    ATPOT reference(A0, 0, 127, config.deadZone);
+    finalValue = ideal(reference, trace.clean(trace.duration));
+
+    hostsim::now = 0;
+    hostsim::signal = trace.signal;
+    ATMIDIOUT limiter(onSend);
+    limiter.setRate(RATE);
+    out = &limiter;
+
+    ATPOT pot(A0, 0, 127, config.deadZone, onChange);
+    pot.setNumReadings(config.readings);
+    pot.setDebounceThreshold(config.threshold);
+    pot.setHysteresis(config.hysteresis);
+    pot.setAdaptive(config.smoothing, config.response);
+    if (config.engine) {
+        ATADC::begin(A0);
+    } else {
+        ATADC::end();
+    }
+
+    unsigned long nextConversion = 0;
+    unsigned long errorSamples = 0;
+    double errorSum = 0;
+    while (hostsim::now < trace.duration) {
+        if (config.engine) {
+            while (nextConversion <= hostsim::now) {
+                ATADC::store(trace.signal(nextConversion));
+                nextConversion += CONVERSION_US;
+            }
+        }
+        pot.scan();
+        limiter.update();
+
+        if (trace.kind == SWEEP && output >= 0) {
+            int error = abs(output - ideal(reference, trace.clean(hostsim::now)));
+            errorSum += error;
+            errorSamples++;
+            result.maxError = max(result.maxError, error);
+        }
+        hostsim::now += LOOP_US;
+    }
+
+    result.meanError = errorSamples ? errorSum / errorSamples : 0;
+    result.finalError = output - finalValue;
+    if (trace.kind == STEP && reachedAt >= 0) {
+        result.settleLatency = reachedAt - STEP_AT;
+    }
+    return result;
+}
+
+static void printHeader(const Trace& trace)
+{
+    printf("\n== %s ==\n", trace.name);
+    printf("%-5s %8s %9s %8s %4s %7s | %7s %7s |", "adc", "readings", "threshold", "deadzone", "hyst", "adapt", "events",
+        "sent");
+    switch (trace.kind) {
+    case IDLE:
+    case REPLAY:
+        printf(" %11s %9s\n", "idle events", "idle span");
+        break;
+    case STEP:
+        printf(" %10s %10s %9s\n", "first(us)", "settle(us)", "final err");
+        break;
+    case SWEEP:
+        printf(" %9s %9s %9s\n", "mean err", "max err", "final err");
+        break;
+    }
+}
+
+static void printRow(const Trace& trace, const Config& config, const Result& r)
+{
+    char adapt[8] = "off";
+    if (config.smoothing) {
+        snprintf(adapt, sizeof(adapt), "%d/%d", config.smoothing, config.response);
+    }
+    printf("%-5s %8d %9d %8.1f %4d %7s | %7lu %7lu |", config.engine ? "isr" : "poll", config.readings, config.threshold,
+        config.deadZone, config.hysteresis, adapt, r.events, r.sent);
+    switch (trace.kind) {
+    case IDLE:
+    case REPLAY:
+        printf(" %11lu %9d\n", r.idleEvents, r.idleEvents ? r.spanHi - r.spanLo : 0);
+        break;
+    case STEP:
+        printf(" %10ld %10ld %9d\n", r.firstLatency, r.settleLatency, r.finalError);
+        break;
+    case SWEEP:
+        printf(" %9.2f %9d %9d\n", r.meanError, r.maxError, r.finalError);
+        break;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Trace traces[] = {
+        { "noisy idle (512 +/- 8 LSB, rare spikes), 1 s", IDLE, 1000000, idleSignal, idleClean },
+        { "step 200 -> 820 at 100 ms, 300 ms", STEP, 300000, stepSignal, stepClean },
+        { "sweep 0 -> 1023 -> 0 in 400 ms, 500 ms", SWEEP, 500000, sweepSignal, sweepClean },
+    };
+    int traceCount = 3;
+
+    if (argc > 1) {
+        if (!loadReplay(argv[1])) {
+            fprintf(stderr, "can not read trace %s\n", argv[1]);
+            return 1;
+        }
+        traces[0] = { argv[1], REPLAY, replayTimes[replayCount - 1] + CONVERSION_US, replaySignal, replaySignal };
+        traceCount = 1;
+    }
+
+    const int readings[] = { 4, 8, 16 };
+    const int thresholds[] = { 1, 3, 5 };
+    const float deadZones[] = { 0, 10 };
+    const byte hystereses[] = { 0, 50 };
+    const byte adaptive[][2] = { { 64, 16 }, { 127, 32 } }; // smoothing, response
+
+    for (int t = 0; t < traceCount; t++) {
+        printHeader(traces[t]);
+        for (int e = 1; e >= 0; e--) {
+            for (int r = 0; r < 3; r++) {
+                for (int h = 0; h < 3; h++) {
+                    for (int d = 0; d < 2; d++) {
+                        for (int y = 0; y < 2; y++) {
+                            Config config = { readings[r], thresholds[h], deadZones[d], hystereses[y], 0, 0, e == 1 };
+                            printRow(traces[t], config, run(traces[t], config));
+                        }
+                    }
+                }
+            }
+        }
+        // adaptive filter on a short window, against the fixed filter rows above
+        for (int e = 1; e >= 0; e--) {
+            for (int h = 0; h < 2; h++) {
+                for (int y = 0; y < 2; y++) {
+                    for (int a = 0; a < 2; a++) {
+                        Config config = { 4, thresholds[h], 0, hystereses[y], adaptive[a][0], adaptive[a][1], e == 1 };
+                        printRow(traces[t], config, run(traces[t], config));
+                    }
+                }
+            }
+        }
+    }
+    return 0;
+}
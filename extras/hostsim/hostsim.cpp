@@ -0,0 +1,86 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Mock Arduino core functions for the host simulation.
+ *****************************************************************************/
+
+#include "Arduino.h"
+
+unsigned long hostsim::now = 0;
+int (*hostsim::signal)(unsigned long us) = nullptr;
+HostSerial Serial;
+HostSerial Serial1;
+
+/**
+ * @brief Same integer mapping as the Arduino core.
+ */
+long map(long x, long in_min, long in_max, long out_min, long out_max)
+{
+    return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+/**
+ * @brief Returns the simulated signal and advances the clock by one conversion.
+ */
+int analogRead(uint8_t)
+{
+    int value = hostsim::signal ? hostsim::signal(hostsim::now) : 0;
+    hostsim::now += hostsim::ANALOG_READ_US;
+    return value;
+}
+
+unsigned long millis()
+{
+    return hostsim::now / 1000;
+}
+
+unsigned long micros()
+{
+    return hostsim::now;
+}
+
+void HostSerial::begin(unsigned long baud)
+{
+    _byteUS = 10000000UL / baud; // start, 8 data and stop bit
+    _queued = 0;
+}
+
+int HostSerial::availableForWrite()
+{
+    drain();
+    return hostsim::SERIAL_TX_BUFFER - _queued;
+}
+
+size_t HostSerial::write(uint8_t)
+{
+    drain();
+    if (_queued == hostsim::SERIAL_TX_BUFFER) {
+        hostsim::now = _sentAt + _byteUS; // blocks until the oldest byte is out
+        drain();
+    }
+    if (!_queued) {
+        _sentAt = hostsim::now;
+    }
+    _queued++;
+    written++;
+    return 1;
+}
+
+/**
+ * @brief Removes the bytes the UART has shifted out since the last call.
+ */
+void HostSerial::drain()
+{
+    if (!_byteUS) {
+        _queued = 0; // not opened, nothing to wait for
+        return;
+    }
+    while (_queued && hostsim::now - _sentAt >= _byteUS) {
+        _queued--;
+        _sentAt += _byteUS;
+    }
+}
@@ -0,0 +1,139 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Host check for ATMIDIIN: one pass of handleMidiInput() takes every message
+ * for the pedal, also when channel messages for other devices are queued in
+ * front of them.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++11 -O2 -Iextras/hostsim -I. extras/hostsim/hostsim.cpp extras/hostsim/midiin.cpp -o midiin
+ *
+ * Run:
+ *   ./midiin             prints the messages taken per case, exits 1 on a failure
+ *****************************************************************************/
+
+#include <stdio.h>
+
+#include "ATMIDIIN.h"
+
+/**
+ * @brief One queued message: status byte (type | channel - 1), two data bytes.
+ */
+struct Message {
+    byte status;
+    byte data1;
+    byte data2;
+};
+
+/**
+ * @brief MIDI interface with the input filter of the MIDI library.
+ *
+ * @details As `MidiInterface::read()`: a message is taken from the input whatever its channel,
+ *          and a channel message for another channel than the one asked for returns false.
+ */
+class HostMidi {
+
+public:
+    void begin(byte channel)
+    {
+        _inputChannel = channel;
+    }
+
+    void queue(const Message* messages, byte count)
+    {
+        _messages = messages;
+        _count = count;
+        _next = 0;
+    }
+
+    bool read()
+    {
+        return read(_inputChannel);
+    }
+
+    bool read(byte channel)
+    {
+        if (_next >= _count) {
+            return false;
+        }
+        _current = _messages[_next++];
+        bool system = _current.status >= 0xF0;
+        return system || channel == MIDI_CHANNEL_OMNI || getChannel() == channel;
+    }
+
+    byte getType() const
+    {
+        return _current.status >= 0xF0 ? _current.status : _current.status & 0xF0;
+    }
+
+    byte getChannel() const
+    {
+        return (_current.status & 0x0F) + 1;
+    }
+
+    byte getData1() const
+    {
+        return _current.data1;
+    }
+
+private:
+    const Message* _messages = nullptr;
+    byte _count = 0;
+    byte _next = 0;
+    byte _inputChannel = 1;
+    Message _current = { 0, 0, 0 };
+};
+
+/** @brief A channel 2 CC for another device, then a channel 1 config CC (CC 33) and a SysEx. */
+const Message MIXED[] = {
+    { 0xB1, 7, 100 },
+    { 0xB0, 33, 11 },
+    { 0xF0, 0, 0 },
+};
+
+/** @brief Messages a pass has to take from `MIXED`. */
+const byte EXPECTED = 2;
+
+/**
+ * @brief Runs one pass of the input loop on `MIXED`.
+ *
+ * @param filtered true to read through `ATMIDIIN`, false for a plain `read()` loop.
+ * @return The number of messages for the pedal taken in the pass.
+ */
+static byte pass(bool filtered)
+{
+    HostMidi midi;
+    midi.begin(1);
+    midi.queue(MIXED, sizeof(MIXED) / sizeof(MIXED[0]));
+    ATMIDIIN<HostMidi> input(midi, 1);
+
+    byte taken = 0;
+    while (filtered ? input.read() : midi.read()) {
+        printf("  type %02X ch %d data %d\n", midi.getType(), midi.getType() < 0xF0 ? midi.getChannel() : 0,
+            midi.getData1());
+        taken++;
+    }
+    return taken;
+}
+
+int main()
+{
+    printf("plain read():\n");
+    byte plain = pass(false);
+    printf("  %d of %d taken (the channel 2 CC ends the pass)\n", plain, EXPECTED);
+
+    printf("ATMIDIIN::read():\n");
+    byte filtered = pass(true);
+    printf("  %d of %d taken\n", filtered, EXPECTED);
+
+    if (filtered != EXPECTED) {
+        printf("FAIL\n");
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
@@ -0,0 +1,104 @@
+/*****************************************************************************
+ * Copyright © Amit Talwar www.amitszone.com
+ * You are free to use this project for your own personal non commercial use.
+ * by Using this project and code you agree and understand that you are
+ * prohibited to build and sell this to others for profit.
+ ******************************************************************************/
+/*****************************************************************************
+ * Turns a raw trace exported by the pedal (CC 48, then SysEx 70) into a replay
+ * file for the benchmark.
+ *
+ * Build from the repository root:
+ *   g++ -std=c++11 -O2 -Iextras/hostsim -I. ATTRACE.cpp ATSYSEX.cpp extras/hostsim/hostsim.cpp \
+ *       extras/hostsim/untrace.cpp -o untrace
+ *
+ * Run:
+ *   ./untrace capture.syx > trace.txt    the SysEx messages as received (binary, F0 ... F7)
+ *   ./bench trace.txt
+ *
+ * Prints one "time_us value" line per sample, the time from the first sample.
+ *****************************************************************************/
+
+#include <stdio.h>
+
+#include "ATSYSEX.h"
+#include "ATTRACE.h"
+
+/** @brief SysEx reply describing the exported trace (`sysexCaptureHeader` of the sketch). */
+const byte CAPTURE_HEADER = 0x71;
+/** @brief SysEx reply carrying one chunk of the trace (`sysexCaptureChunk` of the sketch). */
+const byte CAPTURE_CHUNK = 0x72;
+
+static byte trace[65536];
+static unsigned long traceLength = 0;
+static unsigned long received = 0;
+static unsigned long period = 0;
+static byte every = 1;
+
+/**
+ * @brief Takes one received SysEx message, including F0 and F7.
+ */
+static void receive(const byte* message, unsigned length)
+{
+    int command = ATSYSEX::command(message, length);
+    if (command == CAPTURE_HEADER && length >= 21) {
+        every = message[5];
+        period = ATSYSEX::get16(message + 6);
+        traceLength = ATSYSEX::get16(message + 12);
+        fprintf(stderr, "state %d, every %d, period %lu us, %u samples, %lu bytes\n", message[4], message[5],
+            period, ATSYSEX::get16(message + 9), traceLength);
+    } else if (command == CAPTURE_CHUNK && length >= 8) {
+        unsigned long offset = ATSYSEX::get16(message + 4);
+        byte data[SYSEX_MAX_SIZE];
+        unsigned count = ATSYSEX::getPacked(message + 7, length - 8, data);
+        for (unsigned i = 0; i < count && offset + i < sizeof(trace); i++) {
+            trace[offset + i] = data[i];
+        }
+        received += count;
+    }
+}
+
+/**
+ * @brief Prints one decoded sample.
+ */
+static void print(unsigned long index, int value)
+{
+    printf("%lu %d\n", index * period, value);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s capture.syx\n", argv[0]);
+        return 1;
+    }
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    static byte message[1024];
+    unsigned length = 0;
+    int c;
+    while ((c = fgetc(file)) != EOF) {
+        if (c == 0xF0) {
+            length = 0;
+        }
+        if (length < sizeof(message)) {
+            message[length++] = c;
+        }
+        if (c == 0xF7) {
+            receive(message, length);
+            length = 0;
+        }
+    }
+    fclose(file);
+
+    if (!period || received < traceLength) {
+        fprintf(stderr, "incomplete trace, %lu of %lu bytes\n", received, traceLength);
+        return 1;
+    }
+    ATTRACE::decode(trace, traceLength, every, print);
+    return 0;
+}
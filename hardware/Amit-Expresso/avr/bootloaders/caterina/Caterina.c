@@ -61,9 +61,17 @@ static bool RunBootloader = true;
 uint16_t TxLEDPulse = 0; // time remaining for Tx LED pulse
 uint16_t RxLEDPulse = 0; // time remaining for Rx LED pulse
 
-/* Bootloader timeout timer */
-#define TIMEOUT_PERIOD	8000
+/* Bootloader timeout timer, in ms. TIMEOUT_PERIOD is the wait after an external reset, short so a
+ * pedal reset mid-show is back quickly, REQUEST_TIMEOUT_PERIOD the wait after the sketch asked for the
+ * bootloader (boot key set), long enough for the upload tool. Override both with -D when building. */
+#ifndef TIMEOUT_PERIOD
+#define TIMEOUT_PERIOD	750
+#endif
+#ifndef REQUEST_TIMEOUT_PERIOD
+#define REQUEST_TIMEOUT_PERIOD	8000
+#endif
 uint16_t Timeout = 0;
+uint16_t TimeoutPeriod = TIMEOUT_PERIOD;
 
 uint16_t bootKey = 0x7777;
 volatile uint16_t *const bootKeyPtr = (volatile uint16_t *)0x0800;
@@ -121,6 +129,11 @@ int main(void)
 	/* Watchdog may be configured with a 15 ms period so must disable it before going any further */
 	wdt_disable();
 	
+	if (bootKeyPtrVal == bootKey) {
+		// The sketch asked for the bootloader (1200 bps touch or SysEx), wait for the upload.
+		TimeoutPeriod = REQUEST_TIMEOUT_PERIOD;
+	}
+
 	if (mcusr_state & (1<<EXTRF)) {
 		// External reset -  we should continue to self-programming mode.
 	} else if ((mcusr_state & (1<<PORF)) && (pgm_read_word(0) != 0xFFFF)) {		
@@ -145,7 +158,7 @@ int main(void)
 		CDC_Task();
 		USB_USBTask();
 		/* Time out and start the sketch if one is present */
-		if (Timeout > TIMEOUT_PERIOD)
+		if (Timeout > TimeoutPeriod)
 			RunBootloader = false;
 
 		LEDPulse();
@@ -486,7 +499,7 @@ void CDC_Task(void)
 		* leaving just a few hundred milliseconds so the 
 		* bootloder has time to respond and service any 
 		* subsequent requests */
-		Timeout = TIMEOUT_PERIOD - 500;
+		Timeout = TimeoutPeriod > 500 ? TimeoutPeriod - 500 : 0;
 	
 		/* Re-enable RWW section - must be done here in case 
 		 * user has disabled verification on upload.  */